@@ -0,0 +1,56 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+
+using namespace std;
+
+AssetLoader::AssetLoader(const vector<MeshFiles>& files, unsigned numThreads) : files(files)
+{
+    if (numThreads == 0) numThreads = max(1u, thread::hardware_concurrency());
+    numThreads = (unsigned)min<size_t>(numThreads, files.size());
+
+    for (unsigned i = 0; i < numThreads; i++)
+        workers.emplace_back(&AssetLoader::run, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+    stopping = true;
+    for (thread& worker : workers)
+        worker.join();
+}
+
+bool AssetLoader::poll(LoadedMesh& loaded)
+{
+    lock_guard<mutex> guard(lock);
+    if (ready.empty()) return false;
+
+    loaded = std::move(ready.front());
+    ready.pop_front();
+    polled++;
+    return true;
+}
+
+bool AssetLoader::done()
+{
+    lock_guard<mutex> guard(lock);
+    return polled == files.size();
+}
+
+void AssetLoader::run()
+{
+    while (!stopping) {
+        size_t i = next++;
+        if (i >= files.size()) return;
+
+        // The slow part runs without holding the lock
+        LoadedMesh loaded;
+        loaded.index = i;
+        loaded.files = files[i];
+        loaded.mesh.reset(new CookedMesh());
+        if (!loadCookedMesh(files[i], *loaded.mesh)) loaded.mesh.reset();
+
+        lock_guard<mutex> guard(lock);
+        ready.push_back(std::move(loaded));
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MeshCache.h"
+
+// A mesh that is ready to upload. mesh is null if loading failed.
+struct LoadedMesh
+{
+    size_t index;                     // in the list the loader was given
+    MeshFiles files;
+    std::unique_ptr<CookedMesh> mesh;
+};
+
+// Loads meshes (mapping their caches, or parsing and cooking them) on a pool
+// of worker threads, so the GL thread only has to upload. Finished meshes
+// queue up in the order they finish; poll() takes one without blocking.
+class AssetLoader
+{
+public:
+    // numThreads 0 = hardware concurrency, never more than there are meshes
+    explicit AssetLoader(const std::vector<MeshFiles>& files, unsigned numThreads = 0);
+
+    // Meshes not yet started are abandoned; ones in progress are finished
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    bool poll(LoadedMesh& loaded);
+
+    // True once every mesh has been loaded and polled
+    bool done();
+
+    size_t total() const { return files.size(); }
+
+private:
+    std::vector<MeshFiles> files;
+    std::atomic<size_t> next{0};
+    std::atomic<bool> stopping{false};
+    std::vector<std::thread> workers;
+
+    std::mutex lock;
+    std::deque<LoadedMesh> ready;
+    size_t polled = 0;
+
+    void run();
+};
+
+#endif
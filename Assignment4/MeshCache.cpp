@@ -0,0 +1,382 @@
+#include "MeshCache.h"
+#include "LoadBitmap.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+const char MAGIC[8] = {'A', '4', 'M', 'E', 'S', 'H', 0, 0};
+
+// Read-only view of a whole file
+const char* mapFile(const string& path, size_t& size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return nullptr;
+
+    // The view keeps the mapping alive
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    size = (size_t)fileSize.QuadPart;
+    return (const char*)view;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return nullptr;
+
+    size = (size_t)st.st_size;
+    return (const char*)view;
+#endif
+}
+
+void unmapFile(const char* data, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+uint64_t hashFile(const string& path)
+{
+    // FNV-1a, 64 bit
+    uint64_t hash = 14695981039346656037ull;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return 0;
+
+    vector<unsigned char> buffer(1 << 16);
+    size_t got;
+    while ((got = fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            hash ^= buffer[i];
+            hash *= 1099511628211ull;
+        }
+    }
+    fclose(file);
+    return hash;
+}
+
+// Size and time only; the hash is filled in separately since it reads the file
+bool statFile(const string& path, MeshSourceStamp& stamp)
+{
+    error_code ec;
+    stamp.size = fs::file_size(path, ec);
+    if (ec) return false;
+    stamp.modified = fs::last_write_time(path, ec).time_since_epoch().count();
+    if (ec) return false;
+    stamp.hash = 0;
+    return true;
+}
+
+unsigned levelSize(unsigned size, int level)
+{
+    return max(1u, size >> level);
+}
+
+// Every array in the file has to lie inside it
+bool headerIsSane(const MeshCacheHeader& header, uint64_t fileSize)
+{
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+    if (header.version != MESH_CACHE_VERSION || header.vertexSize != sizeof(VertexData)) return false;
+    if (header.fileSize != fileSize) return false;
+
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t elementSize) {
+        return offset <= fileSize && count <= (fileSize - offset) / elementSize;
+    };
+    if (!fits(header.vertexOffset, header.vertexCount, sizeof(VertexData))) return false;
+    if (!fits(header.faceOffset, header.faceCount, sizeof(TriData))) return false;
+
+    if (header.levelCount < 1 || header.levelCount > MESH_CACHE_MAX_LEVELS) return false;
+    if (header.width == 0 || header.height == 0) return false;
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        uint64_t pixels = (uint64_t)levelSize(header.width, level) * levelSize(header.height, level);
+        if (!fits(header.levelOffset[level], pixels, 4)) return false;
+    }
+    return true;
+}
+
+// A source is unchanged if its size matches and either its time or its
+// contents do. changed is set when only the time moved.
+bool sourceMatches(const string& path, MeshSourceStamp& recorded, bool& changed)
+{
+    MeshSourceStamp now;
+    if (!statFile(path, now) || now.size != recorded.size) return false;
+    if (now.modified == recorded.modified) return true;
+
+    if (hashFile(path) != recorded.hash) return false;
+    recorded.modified = now.modified;
+    changed = true;
+    return true;
+}
+
+// 2x2 box filter of a BGRA image. Odd edges reuse their last row or column.
+void downsample(const unsigned char* src, unsigned w, unsigned h, unsigned char* dst, unsigned dw, unsigned dh)
+{
+    for (unsigned y = 0; y < dh; y++) {
+        unsigned y0 = min(2 * y, h - 1), y1 = min(2 * y + 1, h - 1);
+        for (unsigned x = 0; x < dw; x++) {
+            unsigned x0 = min(2 * x, w - 1), x1 = min(2 * x + 1, w - 1);
+            const unsigned char* a = src + 4 * (y0 * w + x0);
+            const unsigned char* b = src + 4 * (y0 * w + x1);
+            const unsigned char* c = src + 4 * (y1 * w + x0);
+            const unsigned char* d = src + 4 * (y1 * w + x1);
+            unsigned char* out = dst + 4 * (y * dw + x);
+            for (int k = 0; k < 4; k++)
+                out[k] = (unsigned char)((a[k] + b[k] + c[k] + d[k] + 2) / 4);
+        }
+    }
+}
+
+// Builds the whole cache file in memory
+bool cookImage(const MeshFiles& files, vector<char>& image)
+{
+    MeshCacheHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(VertexData);
+
+    if (!statFile(files.ply, header.ply) || !statFile(files.bmp, header.bmp)) {
+        cerr << files.ply << ": mesh or texture is missing\n";
+        return false;
+    }
+    header.ply.hash = hashFile(files.ply);
+    header.bmp.hash = hashFile(files.bmp);
+
+    vector<VertexData> vertices;
+    vector<TriData> faces;
+    if (!readPLYFile(files.ply, vertices, faces)) return false;
+
+    unsigned char* pixels = nullptr;
+    unsigned int width = 0, height = 0;
+    loadARGB_BMP(files.bmp.c_str(), &pixels, &width, &height);
+    if (!pixels || width == 0 || height == 0 || width > 32768 || height > 32768) {
+        cerr << files.bmp << ": can't use this texture\n";
+        delete[] pixels;
+        return false;
+    }
+
+    auto align = [](uint64_t offset) { return (offset + 15) & ~uint64_t(15); };
+    uint64_t offset = align(sizeof(MeshCacheHeader));
+
+    header.vertexCount = vertices.size();
+    header.vertexOffset = offset;
+    offset = align(offset + vertices.size() * sizeof(VertexData));
+
+    header.faceCount = faces.size();
+    header.faceOffset = offset;
+    offset = align(offset + faces.size() * sizeof(TriData));
+
+    // Mip levels down to 1x1
+    header.width = width;
+    header.height = height;
+    for (int level = 0; level < MESH_CACHE_MAX_LEVELS; level++) {
+        unsigned w = levelSize(width, level), h = levelSize(height, level);
+        header.levelOffset[level] = offset;
+        header.levelCount = level + 1;
+        offset = align(offset + (uint64_t)w * h * 4);
+        if (w == 1 && h == 1) break;
+    }
+    header.fileSize = offset;
+
+    image.assign(offset, 0);
+    char* out = image.data();
+    memcpy(out, &header, sizeof(header));
+    if (!vertices.empty()) memcpy(out + header.vertexOffset, vertices.data(), vertices.size() * sizeof(VertexData));
+    if (!faces.empty()) memcpy(out + header.faceOffset, faces.data(), faces.size() * sizeof(TriData));
+    memcpy(out + header.levelOffset[0], pixels, (size_t)width * height * 4);
+    delete[] pixels;
+
+    for (uint32_t level = 1; level < header.levelCount; level++) {
+        downsample((unsigned char*)out + header.levelOffset[level - 1], levelSize(width, level - 1), levelSize(height, level - 1),
+            (unsigned char*)out + header.levelOffset[level], levelSize(width, level), levelSize(height, level));
+    }
+    return true;
+}
+
+// Written next to the cache and renamed over it, so a crash never leaves a
+// half-written cache behind
+bool writeCache(const string& path, const vector<char>& image)
+{
+    error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+
+    string temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(image.data(), 1, image.size(), file) == image.size();
+    ok = (fclose(file) == 0) && ok;
+
+    if (ok) fs::rename(temp, path, ec);
+    if (!ok || ec) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+string lowercase(string s)
+{
+    for (char& c : s) c = (char)tolower((unsigned char)c);
+    return s;
+}
+
+} // namespace
+
+vector<MeshFiles> findMeshFiles(const string& dir)
+{
+    map<string, string> plys, bmps;
+    error_code ec;
+    for (const auto& file : fs::directory_iterator(dir, ec)) {
+        if (!file.is_regular_file()) continue;
+
+        string extension = lowercase(file.path().extension().string());
+        string stem = lowercase(file.path().stem().string());
+        if (extension == ".ply") plys[stem] = file.path().string();
+        if (extension == ".bmp") bmps[stem] = file.path().string();
+    }
+
+    vector<MeshFiles> pairs;
+    for (const auto& ply : plys) {
+        auto bmp = bmps.find(ply.first);
+        if (bmp == bmps.end()) {
+            cerr << ply.second << " has no texture, skipped\n";
+            continue;
+        }
+        pairs.push_back({ply.second, bmp->second});
+    }
+    return pairs;
+}
+
+unsigned CookedMesh::levelWidth(int level) const
+{
+    return levelSize(header().width, level);
+}
+
+unsigned CookedMesh::levelHeight(int level) const
+{
+    return levelSize(header().height, level);
+}
+
+void CookedMesh::release()
+{
+    if (mapped && data) unmapFile(data, size);
+    data = nullptr;
+    size = 0;
+    mapped = false;
+    owned.clear();
+    owned.shrink_to_fit();
+}
+
+string meshCachePath(const MeshFiles& files)
+{
+    fs::path ply(files.ply);
+    return (ply.parent_path() / "cache" / (ply.stem().string() + ".mesh")).string();
+}
+
+bool cookMesh(const MeshFiles& files)
+{
+    vector<char> image;
+    if (!cookImage(files, image)) return false;
+    if (!writeCache(meshCachePath(files), image)) {
+        cerr << meshCachePath(files) << " could not be written\n";
+        return false;
+    }
+    return true;
+}
+
+bool meshCacheIsCurrent(const MeshFiles& files)
+{
+    string path = meshCachePath(files);
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    MeshCacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+
+    error_code ec;
+    uint64_t fileSize = fs::file_size(path, ec);
+    if (!ok || ec || !headerIsSane(header, fileSize)) return false;
+
+    bool changed = false;
+    if (!sourceMatches(files.ply, header.ply, changed) || !sourceMatches(files.bmp, header.bmp, changed)) return false;
+
+    // Same contents under a new time: record the time so the next check
+    // doesn't have to hash again
+    if (changed) {
+        file = fopen(path.c_str(), "r+b");
+        if (file) {
+            fwrite(&header, sizeof(header), 1, file);
+            fclose(file);
+        }
+    }
+    return true;
+}
+
+bool loadCookedMesh(const MeshFiles& files, CookedMesh& mesh, bool* wasCooked)
+{
+    mesh.release();
+    string path = meshCachePath(files);
+
+    if (meshCacheIsCurrent(files)) {
+        size_t size = 0;
+        const char* data = mapFile(path, size);
+        if (data && size >= sizeof(MeshCacheHeader) && headerIsSane(*reinterpret_cast<const MeshCacheHeader*>(data), size)) {
+            mesh.data = data;
+            mesh.size = size;
+            mesh.mapped = true;
+            if (wasCooked) *wasCooked = false;
+            return true;
+        }
+        if (data) unmapFile(data, size);
+    }
+
+    if (wasCooked) *wasCooked = true;
+    if (!cookImage(files, mesh.owned)) return false;
+
+    // Failing to write only means cooking again next time
+    if (!writeCache(path, mesh.owned))
+        cerr << path << " could not be written, using the mesh without caching it\n";
+
+    mesh.data = mesh.owned.data();
+    mesh.size = mesh.owned.size();
+    return true;
+}
@@ -0,0 +1,114 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "PLYReader.h"
+
+// A ply and the bmp that textures it
+struct MeshFiles
+{
+    std::string ply;
+    std::string bmp;
+};
+
+// Pairs every .ply in dir with the .bmp of the same name, ignoring case
+// (Bottles.ply and bottles.bmp), sorted by name
+std::vector<MeshFiles> findMeshFiles(const std::string& dir);
+
+// Cooked meshes live next to their sources, in <dir>/cache/<ply name>.mesh.
+//
+// The file is the vertex and index arrays exactly as glBufferData takes them,
+// then the texture as BGRA pixels with its whole mip chain, ready for
+// glTexImage2D. Loading it is a memory map and a few pointer additions.
+//
+// The header records the size, modification time and FNV-1a hash of both
+// sources. A cache is used if the sizes match and either the times match or,
+// when only the time moved (a fresh checkout), the contents still hash the
+// same. Anything else, or a different MESH_CACHE_VERSION, is cooked again.
+const uint32_t MESH_CACHE_VERSION = 1;
+const int MESH_CACHE_MAX_LEVELS = 16;
+
+struct MeshSourceStamp
+{
+    uint64_t size;
+    int64_t modified;
+    uint64_t hash;
+};
+
+struct MeshCacheHeader
+{
+    char magic[8];                  // "A4MESH\0\0"
+    uint32_t version;
+    uint32_t vertexSize;            // sizeof(VertexData) when cooked
+    MeshSourceStamp ply, bmp;
+
+    uint64_t vertexCount, vertexOffset;
+    uint64_t faceCount, faceOffset;
+
+    uint32_t width, height;         // of mip level 0
+    uint32_t levelCount;
+    uint32_t unused;
+    uint64_t levelOffset[MESH_CACHE_MAX_LEVELS];
+    uint64_t fileSize;
+};
+
+// The arrays and pixels of a cooked mesh. They point into a mapped cache
+// file, or into memory if the cache could not be written. Valid until
+// release() or destruction.
+class CookedMesh
+{
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::vector<char> owned;
+
+    const MeshCacheHeader& header() const { return *reinterpret_cast<const MeshCacheHeader*>(data); }
+
+    friend bool loadCookedMesh(const MeshFiles&, CookedMesh&, bool*);
+
+public:
+    CookedMesh() {}
+    ~CookedMesh() { release(); }
+
+    CookedMesh(const CookedMesh&) = delete;
+    CookedMesh& operator=(const CookedMesh&) = delete;
+
+    bool valid() const { return data != nullptr; }
+
+    const VertexData* vertices() const { return reinterpret_cast<const VertexData*>(data + header().vertexOffset); }
+    size_t vertexCount() const { return header().vertexCount; }
+
+    const TriData* faces() const { return reinterpret_cast<const TriData*>(data + header().faceOffset); }
+    size_t faceCount() const { return header().faceCount; }
+
+    // BGRA pixels of one mip level, 0 being the full image
+    int levelCount() const { return header().levelCount; }
+    unsigned levelWidth(int level) const;
+    unsigned levelHeight(int level) const;
+    const unsigned char* levelPixels(int level) const
+    {
+        return reinterpret_cast<const unsigned char*>(data + header().levelOffset[level]);
+    }
+
+    void release();
+};
+
+std::string meshCachePath(const MeshFiles& files);
+
+// Parses both sources and writes their cache file. Returns false if a source
+// can't be read or the file can't be written.
+bool cookMesh(const MeshFiles& files);
+
+// True if the cache file exists and matches the sources
+bool meshCacheIsCurrent(const MeshFiles& files);
+
+// Maps the cache file, cooking it first if it is missing or stale. If the
+// cache can't be written (a read-only folder) the cooked data is kept in
+// memory instead. wasCooked, if given, tells which happened.
+bool loadCookedMesh(const MeshFiles& files, CookedMesh& mesh, bool* wasCooked = nullptr);
+
+#endif
@@ -0,0 +1,569 @@
+#include "PLYReader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static_assert(sizeof(VertexData) == 11 * sizeof(float), "VertexData is read as 11 floats");
+
+namespace {
+
+enum class PLYType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+struct PLYProperty
+{
+    string name;
+    PLYType type = PLYType::Invalid;
+    bool isList = false;
+    PLYType countType = PLYType::Invalid;   // only for lists
+};
+
+struct PLYElement
+{
+    string name;
+    size_t count = 0;
+    vector<PLYProperty> properties;
+};
+
+struct PLYHeader
+{
+    enum Format { Ascii, BinaryLittleEndian, BinaryBigEndian } format = Ascii;
+    vector<PLYElement> elements;
+    size_t dataOffset = 0;   // first byte after "end_header\n"
+};
+
+PLYType parseType(const string& name)
+{
+    if (name == "char" || name == "int8") return PLYType::Int8;
+    if (name == "uchar" || name == "uint8") return PLYType::UInt8;
+    if (name == "short" || name == "int16") return PLYType::Int16;
+    if (name == "ushort" || name == "uint16") return PLYType::UInt16;
+    if (name == "int" || name == "int32") return PLYType::Int32;
+    if (name == "uint" || name == "uint32") return PLYType::UInt32;
+    if (name == "float" || name == "float32") return PLYType::Float32;
+    if (name == "double" || name == "float64") return PLYType::Float64;
+    return PLYType::Invalid;
+}
+
+// Splits one header line into words
+vector<string> words(const char* begin, const char* end)
+{
+    vector<string> out;
+    const char* p = begin;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        const char* start = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r') p++;
+        if (p > start) out.emplace_back(start, p);
+    }
+    return out;
+}
+
+bool parseHeader(const char* data, size_t size, PLYHeader& header, const char* name)
+{
+    const char* p = data;
+    const char* end = data + size;
+    bool first = true;
+
+    while (p < end) {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol) break;
+        vector<string> w = words(p, eol);
+        p = eol + 1;
+
+        if (first) {
+            if (w.size() != 1 || w[0] != "ply") {
+                cerr << name << ": not a PLY file\n";
+                return false;
+            }
+            first = false;
+            continue;
+        }
+        if (w.empty() || w[0] == "comment" || w[0] == "obj_info") continue;
+
+        if (w[0] == "end_header") {
+            header.dataOffset = p - data;
+            return true;
+        }
+        if (w[0] == "format" && w.size() >= 2) {
+            if (w[1] == "ascii") header.format = PLYHeader::Ascii;
+            else if (w[1] == "binary_little_endian") header.format = PLYHeader::BinaryLittleEndian;
+            else if (w[1] == "binary_big_endian") header.format = PLYHeader::BinaryBigEndian;
+            else {
+                cerr << name << ": unknown format " << w[1] << "\n";
+                return false;
+            }
+        }
+        else if (w[0] == "element" && w.size() == 3) {
+            PLYElement element;
+            element.name = w[1];
+            if (from_chars(w[2].data(), w[2].data() + w[2].size(), element.count).ec != errc()) {
+                cerr << name << ": bad count for element " << w[1] << "\n";
+                return false;
+            }
+            header.elements.push_back(element);
+        }
+        else if (w[0] == "property" && !header.elements.empty()) {
+            PLYProperty property;
+            if (w.size() == 5 && w[1] == "list") {
+                property.isList = true;
+                property.countType = parseType(w[2]);
+                property.type = parseType(w[3]);
+                property.name = w[4];
+            }
+            else if (w.size() == 3) {
+                property.type = parseType(w[1]);
+                property.name = w[2];
+            }
+            if (property.type == PLYType::Invalid || (property.isList && property.countType == PLYType::Invalid)) {
+                cerr << name << ": can't read property line\n";
+                return false;
+            }
+            header.elements.back().properties.push_back(property);
+        }
+        else {
+            cerr << name << ": unexpected header line " << w[0] << "\n";
+            return false;
+        }
+    }
+
+    cerr << name << ": header has no end_header\n";
+    return false;
+}
+
+// Reads whitespace separated numbers from the body of an ASCII file
+struct AsciiReader
+{
+    static constexpr bool native = false;
+
+    const char* p;
+    const char* end;
+    bool ok = true;
+
+    void skipSpace()
+    {
+        while (p < end && (unsigned char)*p <= ' ') p++;
+    }
+
+    float readFloat(PLYType)
+    {
+        skipSpace();
+        if (p < end && *p == '+') p++;
+        float value = 0.0f;
+        auto result = from_chars(p, end, value);
+        if (result.ec != errc()) ok = false;
+        p = result.ptr;
+        return value;
+    }
+
+    int64_t readInt(PLYType)
+    {
+        skipSpace();
+        if (p < end && *p == '+') p++;
+        int64_t value = 0;
+        auto result = from_chars(p, end, value);
+        if (result.ec != errc()) ok = false;
+        p = result.ptr;
+        return value;
+    }
+
+    void skip(PLYType)
+    {
+        skipSpace();
+        const char* start = p;
+        while (p < end && (unsigned char)*p > ' ') p++;
+        if (p == start) ok = false;
+    }
+};
+
+size_t typeSize(PLYType type)
+{
+    switch (type) {
+    case PLYType::Int8: case PLYType::UInt8: return 1;
+    case PLYType::Int16: case PLYType::UInt16: return 2;
+    case PLYType::Int32: case PLYType::UInt32: case PLYType::Float32: return 4;
+    case PLYType::Float64: return 8;
+    default: return 0;
+    }
+}
+
+bool hostIsBigEndian()
+{
+    const uint16_t one = 1;
+    unsigned char first;
+    memcpy(&first, &one, 1);
+    return first == 0;
+}
+
+// Reads the body of a binary file. Swap is set when the file's byte order is
+// not the machine's. native readers let the vertex and face loops copy
+// records straight out of the file.
+template <bool Swap>
+struct BinaryReader
+{
+    static constexpr bool native = !Swap;
+
+    const char* p;
+    const char* end;
+    bool ok = true;
+
+    template <typename T>
+    T get()
+    {
+        T value{};
+        if ((size_t)(end - p) < sizeof(T)) {
+            ok = false;
+            p = end;
+            return value;
+        }
+        if (Swap) {
+            char bytes[sizeof(T)];
+            for (size_t i = 0; i < sizeof(T); i++)
+                bytes[i] = p[sizeof(T) - 1 - i];
+            memcpy(&value, bytes, sizeof(T));
+        }
+        else {
+            memcpy(&value, p, sizeof(T));
+        }
+        p += sizeof(T);
+        return value;
+    }
+
+    float readFloat(PLYType type)
+    {
+        switch (type) {
+        case PLYType::Int8: return get<int8_t>();
+        case PLYType::UInt8: return get<uint8_t>();
+        case PLYType::Int16: return get<int16_t>();
+        case PLYType::UInt16: return get<uint16_t>();
+        case PLYType::Int32: return (float)get<int32_t>();
+        case PLYType::UInt32: return (float)get<uint32_t>();
+        case PLYType::Float32: return get<float>();
+        case PLYType::Float64: return (float)get<double>();
+        default: ok = false; return 0.0f;
+        }
+    }
+
+    int64_t readInt(PLYType type)
+    {
+        switch (type) {
+        case PLYType::Int8: return get<int8_t>();
+        case PLYType::UInt8: return get<uint8_t>();
+        case PLYType::Int16: return get<int16_t>();
+        case PLYType::UInt16: return get<uint16_t>();
+        case PLYType::Int32: return get<int32_t>();
+        case PLYType::UInt32: return get<uint32_t>();
+        case PLYType::Float32: return (int64_t)get<float>();
+        case PLYType::Float64: return (int64_t)get<double>();
+        default: ok = false; return 0;
+        }
+    }
+
+    void skip(PLYType type)
+    {
+        size_t n = typeSize(type);
+        if ((size_t)(end - p) < n) {
+            ok = false;
+            p = end;
+            return;
+        }
+        p += n;
+    }
+};
+
+// Where each vertex property goes in VertexData, as a float index (-1 to skip)
+int vertexSlot(const string& name)
+{
+    static const char* names[] = {"x", "y", "z", "nx", "ny", "nz", "red", "green", "blue", "u", "v"};
+    for (int i = 0; i < 11; i++)
+        if (name == names[i]) return i;
+
+    if (name == "s" || name == "texture_u" || name == "texture_s") return 9;
+    if (name == "t" || name == "texture_v" || name == "texture_t") return 10;
+    return -1;
+}
+
+// 8 and 16 bit colours are scaled to 0..1
+float colourScale(PLYType type)
+{
+    if (type == PLYType::UInt8) return 1.0f / 255.0f;
+    if (type == PLYType::UInt16) return 1.0f / 65535.0f;
+    return 1.0f;
+}
+
+template <typename Reader>
+void skipProperty(Reader& in, const PLYProperty& property)
+{
+    if (!property.isList) {
+        in.skip(property.type);
+        return;
+    }
+    int64_t n = in.readInt(property.countType);
+    for (int64_t i = 0; i < n && in.ok; i++)
+        in.skip(property.type);
+}
+
+template <typename Reader>
+bool readVertices(Reader& in, const PLYElement& element, vector<VertexData>& vertices, const char* name)
+{
+    struct Target { int slot; float scale; };
+    vector<Target> targets;
+    for (const PLYProperty& property : element.properties) {
+        int slot = property.isList ? -1 : vertexSlot(property.name);
+        float scale = (slot >= 6 && slot <= 8) ? colourScale(property.type) : 1.0f;
+        targets.push_back({slot, scale});
+    }
+
+    VertexData defaults = {};
+    defaults.r = defaults.g = defaults.b = 1.0f; // White color by default
+    vertices.assign(element.count, defaults);
+
+    // A binary file in the machine's byte order with only float properties
+    // has fixed size vertex records, so the floats are copied straight over
+    if constexpr (Reader::native) {
+        bool allFloat = true;
+        for (const PLYProperty& property : element.properties)
+            allFloat = allFloat && !property.isList && property.type == PLYType::Float32;
+
+        if (allFloat) {
+            size_t stride = element.properties.size() * sizeof(float);
+            if ((size_t)(in.end - in.p) / max(stride, (size_t)1) < element.count) {
+                cerr << name << ": file ends inside the vertices\n";
+                return false;
+            }
+            for (size_t i = 0; i < element.count; i++) {
+                const char* record = in.p + i * stride;
+                float* out = reinterpret_cast<float*>(&vertices[i]);
+                for (size_t k = 0; k < targets.size(); k++)
+                    if (targets[k].slot >= 0) memcpy(out + targets[k].slot, record + k * sizeof(float), sizeof(float));
+            }
+            in.p += element.count * stride;
+            return true;
+        }
+    }
+
+    for (size_t i = 0; i < element.count; i++) {
+        float* out = reinterpret_cast<float*>(&vertices[i]);
+        for (size_t k = 0; k < targets.size(); k++) {
+            const PLYProperty& property = element.properties[k];
+            if (targets[k].slot < 0) {
+                skipProperty(in, property);
+                continue;
+            }
+            out[targets[k].slot] = in.readFloat(property.type) * targets[k].scale;
+        }
+        if (!in.ok) {
+            cerr << name << ": can't read vertex " << i << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Reader>
+bool readFaces(Reader& in, const PLYElement& element, size_t vertexCount, vector<TriData>& faces, const char* name)
+{
+    int listIndex = -1;
+    for (size_t k = 0; k < element.properties.size(); k++) {
+        const PLYProperty& property = element.properties[k];
+        if (property.isList && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+            listIndex = (int)k;
+            break;
+        }
+    }
+    if (listIndex < 0) {
+        cerr << name << ": faces have no vertex_indices list\n";
+        return false;
+    }
+
+    // Polygons are split into a fan around their first vertex, which is
+    // right for the convex faces modelling tools write. Faces with fewer than
+    // three vertices have no area and are dropped.
+    faces.clear();
+    faces.reserve(element.count);
+    vector<int> polygon;
+    size_t dropped = 0;
+
+    auto addPolygon = [&](size_t n) {
+        if (n < 3) {
+            dropped++;
+            return;
+        }
+        for (size_t j = 1; j + 1 < n; j++)
+            faces.push_back({{polygon[0], polygon[j], polygon[j + 1]}});
+    };
+
+    const PLYProperty& list = element.properties[listIndex];
+
+    // A binary file in the machine's byte order whose faces are only a list
+    // of 32 bit indices with a byte count: triangles are copied straight over
+    if constexpr (Reader::native) {
+        if (element.properties.size() == 1 && typeSize(list.countType) == 1
+            && (list.type == PLYType::Int32 || list.type == PLYType::UInt32)) {
+            const char* p = in.p;
+            for (size_t i = 0; i < element.count; i++) {
+                if (in.end - p < 1 || (size_t)(in.end - p - 1) < (unsigned char)*p * (size_t)4) {
+                    cerr << name << ": file ends inside face " << i << "\n";
+                    return false;
+                }
+
+                size_t n = (unsigned char)*p;
+                bool valid = true;
+                if (n == 3) {
+                    TriData tri;
+                    memcpy(tri.indices, p + 1, sizeof(tri.indices));
+                    for (int index : tri.indices)
+                        valid = valid && (uint32_t)index < vertexCount;
+                    if (valid) faces.push_back(tri);
+                }
+                else {
+                    polygon.resize(n);
+                    if (n) memcpy(polygon.data(), p + 1, n * 4);
+                    for (size_t c = 0; c < n; c++)
+                        valid = valid && (uint32_t)polygon[c] < vertexCount;
+                    if (valid) addPolygon(n);
+                }
+                if (!valid) {
+                    cerr << name << ": face " << i << " uses a vertex that doesn't exist\n";
+                    return false;
+                }
+                p += 1 + n * 4;
+            }
+            in.p = p;
+            if (dropped) cerr << name << ": dropped " << dropped << " faces with fewer than 3 vertices\n";
+            return true;
+        }
+    }
+
+    for (size_t i = 0; i < element.count; i++) {
+        for (size_t k = 0; k < element.properties.size(); k++) {
+            const PLYProperty& property = element.properties[k];
+            if ((int)k != listIndex) {
+                skipProperty(in, property);
+                continue;
+            }
+
+            // Every index takes at least one byte, which bounds a bad count
+            int64_t n = in.readInt(property.countType);
+            if (n < 0 || n > in.end - in.p) {
+                in.ok = false;
+                break;
+            }
+            polygon.resize(n);
+            for (int64_t c = 0; c < n; c++) {
+                int64_t index = in.readInt(property.type);
+                if (index < 0 || (size_t)index >= vertexCount) in.ok = false;
+                polygon[c] = (int)index;
+            }
+            if (in.ok) addPolygon(n);
+        }
+        if (!in.ok) {
+            cerr << name << ": can't read face " << i << "\n";
+            return false;
+        }
+    }
+    if (dropped) cerr << name << ": dropped " << dropped << " faces with fewer than 3 vertices\n";
+    return true;
+}
+
+template <typename Reader>
+bool readBody(Reader& in, const PLYHeader& header, vector<VertexData>& vertices, vector<TriData>& faces, const char* name)
+{
+    for (const PLYElement& element : header.elements) {
+        if (element.name == "vertex") {
+            if (!readVertices(in, element, vertices, name)) return false;
+        }
+        else if (element.name == "face") {
+            if (!readFaces(in, element, vertices.size(), faces, name)) return false;
+        }
+        else {
+            for (size_t i = 0; i < element.count && in.ok; i++)
+                for (const PLYProperty& property : element.properties)
+                    skipProperty(in, property);
+            if (!in.ok) {
+                cerr << name << ": can't read element " << element.name << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool parsePLY(const char* data, size_t size, vector<VertexData>& vertices, vector<TriData>& faces, const char* name)
+{
+    vertices.clear();
+    faces.clear();
+
+    PLYHeader header;
+    if (!parseHeader(data, size, header, name)) return false;
+
+    // Every value takes at least one byte, so a count past the end of the
+    // file is a broken header rather than something to allocate for
+    for (const PLYElement& element : header.elements) {
+        if (!element.properties.empty() && element.count > size - header.dataOffset) {
+            cerr << name << ": " << element.name << " count is larger than the file\n";
+            return false;
+        }
+    }
+
+    const char* body = data + header.dataOffset;
+    const char* end = data + size;
+    bool ok;
+    if (header.format == PLYHeader::Ascii) {
+        AsciiReader in{body, end};
+        ok = readBody(in, header, vertices, faces, name);
+    }
+    else if ((header.format == PLYHeader::BinaryBigEndian) == hostIsBigEndian()) {
+        BinaryReader<false> in{body, end};
+        ok = readBody(in, header, vertices, faces, name);
+    }
+    else {
+        BinaryReader<true> in{body, end};
+        ok = readBody(in, header, vertices, faces, name);
+    }
+
+    if (!ok) {
+        vertices.clear();
+        faces.clear();
+        return false;
+    }
+    return true;
+}
+
+bool readPLYFile(const string& fname, vector<VertexData>& vertices, vector<TriData>& faces)
+{
+    // One read of the whole file, then parse from memory
+    FILE* file = fopen(fname.c_str(), "rb");
+    if (!file) {
+        cerr << fname << " could not be opened\n";
+        vertices.clear();
+        faces.clear();
+        return false;
+    }
+
+    // Not ftell: its long is 32 bits on Windows, and scans pass 2 GB
+    error_code ec;
+    uintmax_t size = fs::file_size(fname, ec);
+
+    vector<char> data(ec ? 0 : (size_t)size);
+    size_t got = data.empty() ? 0 : fread(data.data(), 1, data.size(), file);
+    fclose(file);
+
+    if (ec || got != data.size()) {
+        cerr << fname << ": read failed\n";
+        vertices.clear();
+        faces.clear();
+        return false;
+    }
+
+    return parsePLY(data.data(), data.size(), vertices, faces, fname.c_str());
+}
@@ -0,0 +1,44 @@
+#ifndef PLY_READER_H
+#define PLY_READER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+struct VertexData
+{
+    float x, y, z;
+    float nx, ny, nz;
+    float r, g, b;
+    float u, v;
+};
+
+struct TriData
+{
+    int indices[3];
+};
+
+// Reads a PLY mesh into the interleaved vertex and index arrays the renderer
+// uploads. The file is read in one go, the arrays are sized from the element
+// counts in the header, and numbers are parsed with std::from_chars.
+//
+// ascii, binary_little_endian and binary_big_endian files are all read, with
+// any of the PLY scalar types for properties and list counts. Binary files in
+// the machine's byte order with float vertices and uchar-counted int index
+// lists skip the per-value decoding and are copied record by record.
+//
+// Vertex properties are matched by name (x y z, nx ny nz, red green blue,
+// u v or s t), in whatever order the header declares them. Missing ones stay
+// at zero, except the colour which defaults to white. Properties and elements
+// the renderer has no use for are skipped. Faces come from the vertex_indices
+// (or vertex_index) list; polygons are split into a triangle fan.
+//
+// Returns false and prints the reason if the file can't be read or doesn't
+// match its header. The arrays are left empty then.
+bool readPLYFile(const std::string& fname, std::vector<VertexData>& vertices, std::vector<TriData>& faces);
+
+// Same, for a file that is already in memory. name is only used in messages.
+bool parsePLY(const char* data, size_t size, std::vector<VertexData>& vertices, std::vector<TriData>& faces,
+    const char* name = "PLY");
+
+#endif
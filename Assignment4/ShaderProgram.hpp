@@ -0,0 +1,195 @@
+#ifndef SHADER_PROGRAM_HPP
+#define SHADER_PROGRAM_HPP
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+
+// A linked program plus the locations of all of its active uniforms, read
+// once at construction. Keep the locations instead of calling
+// glGetUniformLocation by name every frame.
+class ShaderProgram {
+    GLuint program = 0;
+    std::unordered_map<std::string, GLint> locations;
+
+public:
+    ShaderProgram() {}
+
+    explicit ShaderProgram(GLuint linkedProgram) : program(linkedProgram) {
+        if (!program) return;
+
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<GLchar> name(maxLength + 1);
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, i, name.size(), &length, &size, &type, &name[0]);
+
+            // Members of uniform blocks have no location
+            std::string uniformName(&name[0], length);
+            GLint loc = glGetUniformLocation(program, uniformName.c_str());
+            if (loc < 0) continue;
+
+            locations[uniformName] = loc;
+        }
+    }
+
+    GLuint id() const { return program; }
+    void use() const { glUseProgram(program); }
+
+    // -1 if the uniform is not active, which glUniform* calls ignore
+    GLint location(const std::string& name) const {
+        auto it = locations.find(name);
+        return it == locations.end() ? -1 : it->second;
+    }
+
+    // Returns false if the program does not use the block
+    bool bindBlock(const char* blockName, GLuint binding) const {
+        GLuint index = glGetUniformBlockIndex(program, blockName);
+        if (index == GL_INVALID_INDEX) return false;
+
+        glUniformBlockBinding(program, index, binding);
+        return true;
+    }
+};
+
+// Compiles and links a vertex and fragment shader. Prints the log and
+// returns 0 if either stage or the link fails.
+inline GLuint buildProgram(const std::string& vertexSource, const std::string& fragmentSource) {
+    const char* sources[2] = {vertexSource.c_str(), fragmentSource.c_str()};
+    const GLenum stages[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    const char* names[2] = {"Vertex", "Fragment"};
+
+    GLint success;
+    GLchar infoLog[512];
+    GLuint shaders[2] = {0, 0};
+    bool compiled = true;
+
+    for (int i = 0; i < 2; ++i) {
+        shaders[i] = glCreateShader(stages[i]);
+        glShaderSource(shaders[i], 1, &sources[i], NULL);
+        glCompileShader(shaders[i]);
+
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(shaders[i], 512, NULL, infoLog);
+            printf("ERROR: %s Shader Compilation Failed\n %s", names[i], infoLog);
+            compiled = false;
+        }
+    }
+
+    GLuint program = 0;
+    if (compiled) {
+        program = glCreateProgram();
+        glAttachShader(program, shaders[0]);
+        glAttachShader(program, shaders[1]);
+        glLinkProgram(program);
+
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            printf("ERROR: Shader Program Linking Failed\n %s\n", infoLog);
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    // The program keeps what it needs after linking
+    glDeleteShader(shaders[0]);
+    glDeleteShader(shaders[1]);
+    return program;
+}
+
+// Programs keyed by their source text, so each distinct pair of shaders is
+// compiled and linked once no matter how many meshes draw with it. The cache
+// owns the programs; release() deletes them and has to run while the context
+// is still current.
+class ShaderCache {
+    std::unordered_map<std::string, std::unique_ptr<ShaderProgram>> programs;
+
+public:
+    ShaderCache() {}
+    ~ShaderCache() { release(); }
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    // Null if the sources don't build; that is remembered too, so the error
+    // is printed once. built is set when this call did the building.
+    const ShaderProgram* get(const std::string& vertexSource, const std::string& fragmentSource, bool* built = nullptr) {
+        // A NUL can't appear in GLSL, so it separates the two sources
+        std::string key = vertexSource;
+        key += '\0';
+        key += fragmentSource;
+
+        auto it = programs.find(key);
+        if (it != programs.end()) {
+            if (built) *built = false;
+            return it->second.get();
+        }
+
+        GLuint program = buildProgram(vertexSource, fragmentSource);
+        std::unique_ptr<ShaderProgram>& slot = programs[key];
+        if (program) slot.reset(new ShaderProgram(program));
+        if (built) *built = program != 0;
+        return slot.get();
+    }
+
+    // Programs built so far, failed ones included
+    size_t size() const { return programs.size(); }
+
+    void release() {
+        for (auto& entry : programs)
+            if (entry.second) glDeleteProgram(entry.second->id());
+        programs.clear();
+    }
+};
+
+// A uniform buffer bound to one binding point. The struct written into it has
+// to match the std140 layout of the block.
+class UniformBuffer {
+    GLuint buffer = 0;
+    size_t size = 0;
+
+public:
+    UniformBuffer() {}
+    ~UniformBuffer() { release(); }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    void create(size_t bytes, GLuint binding) {
+        if (!buffer) glGenBuffers(1, &buffer);
+        size = bytes;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    }
+
+    template <typename T>
+    void update(const T& block) {
+        if (!buffer || sizeof(T) > size) return;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void release() {
+        if (buffer) glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        size = 0;
+    }
+};
+
+#endif
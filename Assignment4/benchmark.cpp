@@ -0,0 +1,377 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "PLYReader.h"
+#include "MeshCache.h"
+#include "LoadBitmap.h"
+#include "AssetLoader.h"
+
+using namespace std;
+using namespace filesystem;
+
+// The reader main.cpp used before PLYReader, kept as the baseline
+void readPLYFileStream(string fname, vector<VertexData> &vertices, vector<TriData> &faces)
+{
+    ifstream file(fname);
+    string line;
+    int vertexCount = 0;
+    int faceCount = 0;
+
+    while (getline(file, line))
+    {
+        if (line.rfind("element vertex", 0) == 0)
+            vertexCount = stoi(line.substr(15));
+        else if (line.rfind("element face", 0) == 0)
+            faceCount = stoi(line.substr(13));
+        else if (line == "end_header")
+            break;
+    }
+
+    for (int i = 0; i < vertexCount; i++)
+    {
+        VertexData v = {};
+        file >> v.x >> v.y >> v.z >> v.nx >> v.ny >> v.nz >> v.u >> v.v;
+        v.r = 1.0f;
+        v.g = 1.0f;
+        v.b = 1.0f;
+        vertices.push_back(v);
+    }
+
+    for (int i = 0; i < faceCount; i++)
+    {
+        int n, v1, v2, v3;
+        file >> n >> v1 >> v2 >> v3;
+        faces.push_back({v1, v2, v3});
+    }
+}
+
+vector<string> plyFiles(const string& dir)
+{
+    vector<string> files;
+    if (!exists(dir)) return files;
+    for (const auto& file : directory_iterator(dir))
+        if (file.is_regular_file() && file.path().extension() == ".ply")
+            files.push_back(file.path().string());
+    sort(files.begin(), files.end());
+    return files;
+}
+
+// Load every file in the set `repeats` times and return the best total over
+// a few runs, in milliseconds
+template <typename Fn>
+double bestOf(int runs, int repeats, const vector<string>& files, Fn load)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        for (int k = 0; k < repeats; k++) {
+            for (const string& f : files) {
+                vector<VertexData> vertices;
+                vector<TriData> faces;
+                load(f, vertices, faces);
+            }
+        }
+        auto end = chrono::steady_clock::now();
+        best = min(best, chrono::duration<double, milli>(end - start).count());
+    }
+    return best;
+}
+
+void benchSet(const char* label, const string& dir, int runs, int repeats)
+{
+    vector<string> files = plyFiles(dir);
+    if (files.empty()) {
+        printf("%-12s no .ply files in %s\n", label, dir.c_str());
+        return;
+    }
+
+    // Both readers have to agree before the times mean anything
+    size_t vertexCount = 0, faceCount = 0, bytes = 0;
+    for (const string& f : files) {
+        vector<VertexData> v1, v2;
+        vector<TriData> f1, f2;
+        readPLYFileStream(f, v1, f1);
+        readPLYFile(f, v2, f2);
+        if (v1.size() != v2.size() || f1.size() != f2.size()
+            || memcmp(v1.data(), v2.data(), v1.size() * sizeof(VertexData)) != 0
+            || memcmp(f1.data(), f2.data(), f1.size() * sizeof(TriData)) != 0)
+            printf("  %s: readers disagree\n", f.c_str());
+        vertexCount += v2.size();
+        faceCount += f2.size();
+        bytes += file_size(f);
+    }
+
+    double tStream = bestOf(runs, repeats, files, readPLYFileStream);
+    double tFast = bestOf(runs, repeats, files, [](const string& f, vector<VertexData>& v, vector<TriData>& t) {
+        readPLYFile(f, v, t);
+    });
+
+    double mb = bytes * (double)repeats / (1024.0 * 1024.0);
+    printf("%-12s %2zu files %6zu verts %6zu faces  ifstream %8.3f ms  PLYReader %8.3f ms  (%.2fx, %.0f MB/s)\n",
+        label, files.size(), vertexCount, faceCount,
+        tStream / repeats, tFast / repeats, tStream / tFast, mb / (tFast / 1000.0));
+}
+
+// The mesh as a binary PLY in memory, with the same properties as our ascii files
+string toBinaryPLY(const vector<VertexData>& vertices, const vector<TriData>& faces, bool bigEndian)
+{
+    string out = "ply\nformat ";
+    out += bigEndian ? "binary_big_endian" : "binary_little_endian";
+    out += " 1.0\nelement vertex " + to_string(vertices.size()) + "\n";
+    for (const char* name : {"x", "y", "z", "nx", "ny", "nz", "u", "v"})
+        out += string("property float ") + name + "\n";
+    out += "element face " + to_string(faces.size()) + "\n";
+    out += "property list uchar uint vertex_indices\nend_header\n";
+
+    const uint16_t one = 1;
+    bool hostBig = *(const unsigned char*)&one == 0;
+    auto put = [&](const void* value, size_t size) {
+        const char* bytes = (const char*)value;
+        for (size_t i = 0; i < size; i++)
+            out += bytes[bigEndian != hostBig ? size - 1 - i : i];
+    };
+
+    for (const VertexData& v : vertices)
+        for (float f : {v.x, v.y, v.z, v.nx, v.ny, v.nz, v.u, v.v})
+            put(&f, sizeof(float));
+    for (const TriData& f : faces) {
+        out += (char)3;
+        for (int index : f.indices)
+            put(&index, sizeof(int));
+    }
+    return out;
+}
+
+string readWhole(const string& fname)
+{
+    ifstream file(fname, ios::binary);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+// parsePLY on files already in memory, so only the parsing is timed
+double bestParse(int runs, int repeats, const vector<string>& buffers)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        for (int k = 0; k < repeats; k++) {
+            for (const string& b : buffers) {
+                vector<VertexData> vertices;
+                vector<TriData> faces;
+                parsePLY(b.data(), b.size(), vertices, faces);
+            }
+        }
+        auto end = chrono::steady_clock::now();
+        best = min(best, chrono::duration<double, milli>(end - start).count());
+    }
+    return best / repeats;
+}
+
+void benchBinary(const char* label, const string& dir, int runs, int repeats)
+{
+    vector<string> files = plyFiles(dir);
+    if (files.empty()) return;
+
+    vector<string> ascii, little, big;
+    for (const string& f : files) {
+        vector<VertexData> vertices;
+        vector<TriData> faces;
+        readPLYFile(f, vertices, faces);
+        ascii.push_back(readWhole(f));
+        little.push_back(toBinaryPLY(vertices, faces, false));
+        big.push_back(toBinaryPLY(vertices, faces, true));
+
+        for (const string* b : {&little.back(), &big.back()}) {
+            vector<VertexData> v2;
+            vector<TriData> f2;
+            parsePLY(b->data(), b->size(), v2, f2);
+            if (v2.size() != vertices.size() || f2.size() != faces.size()
+                || memcmp(v2.data(), vertices.data(), v2.size() * sizeof(VertexData)) != 0
+                || memcmp(f2.data(), faces.data(), f2.size() * sizeof(TriData)) != 0)
+                printf("  %s: binary copy reads back different\n", f.c_str());
+        }
+    }
+
+    double tAscii = bestParse(runs, repeats, ascii);
+    double tLittle = bestParse(runs, repeats, little);
+    double tBig = bestParse(runs, repeats, big);
+    printf("%-12s parse from memory  ascii %8.3f ms  binary LE %8.3f ms (%.1fx)  binary BE %8.3f ms (%.1fx)\n",
+        label, tAscii, tLittle, tAscii / tLittle, tBig, tAscii / tBig);
+}
+
+// The mesh as an ascii PLY in memory, written the way Blender writes ours
+string toAsciiPLY(const vector<VertexData>& vertices, const vector<TriData>& faces)
+{
+    string out = "ply\nformat ascii 1.0\nelement vertex " + to_string(vertices.size()) + "\n";
+    for (const char* name : {"x", "y", "z", "nx", "ny", "nz", "u", "v"})
+        out += string("property float ") + name + "\n";
+    out += "element face " + to_string(faces.size()) + "\n";
+    out += "property list uchar uint vertex_indices\nend_header\n";
+
+    char line[256];
+    for (const VertexData& v : vertices) {
+        snprintf(line, sizeof(line), "%f %f %f %f %f %f %f %f\n", v.x, v.y, v.z, v.nx, v.ny, v.nz, v.u, v.v);
+        out += line;
+    }
+    for (const TriData& f : faces) {
+        snprintf(line, sizeof(line), "3 %d %d %d\n", f.indices[0], f.indices[1], f.indices[2]);
+        out += line;
+    }
+    return out;
+}
+
+// A height field of n x n vertices standing in for a large scan
+void benchLargeMesh(int n, int runs)
+{
+    vector<VertexData> vertices;
+    vector<TriData> faces;
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            float u = i / float(n - 1), v = j / float(n - 1);
+            VertexData vd = {u, 0.1f * sinf(20.0f * u) * cosf(20.0f * v), v, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, u, v};
+            vertices.push_back(vd);
+        }
+    }
+    for (int j = 0; j + 1 < n; j++) {
+        for (int i = 0; i + 1 < n; i++) {
+            int a = j * n + i;
+            faces.push_back({{a, a + n, a + 1}});
+            faces.push_back({{a + 1, a + n, a + n + 1}});
+        }
+    }
+
+    vector<string> ascii = {toAsciiPLY(vertices, faces)};
+    vector<string> little = {toBinaryPLY(vertices, faces, false)};
+    vector<string> big = {toBinaryPLY(vertices, faces, true)};
+
+    double tAscii = bestParse(runs, 1, ascii);
+    double tLittle = bestParse(runs, 1, little);
+    double tBig = bestParse(runs, 1, big);
+    printf("%zu verts %zu faces (%.0f MB ascii, %.0f MB binary)\n",
+        vertices.size(), faces.size(), ascii[0].size() / 1048576.0, little[0].size() / 1048576.0);
+    printf("             parse from memory  ascii %8.1f ms  binary LE %8.1f ms (%.1fx)  binary BE %8.1f ms (%.1fx)\n",
+        tAscii, tLittle, tAscii / tLittle, tBig, tAscii / tBig);
+}
+
+// What setMesh hands to GL for a whole folder: parsing every ply and bmp as
+// before, against mapping the cooked caches. Both copy the arrays and the
+// level 0 pixels into a scratch buffer to stand in for glBufferData and
+// glTexImage2D, so the mapped pages are actually read.
+void benchCache(const char* label, const string& dir, int runs)
+{
+    vector<MeshFiles> meshes = findMeshFiles(dir);
+    if (meshes.empty()) return;
+
+    for (const MeshFiles& files : meshes)
+        if (!meshCacheIsCurrent(files)) cookMesh(files);
+
+    vector<char> scratch;
+    auto upload = [&](const void* data, size_t bytes) {
+        scratch.resize(bytes);
+        if (bytes) memcpy(scratch.data(), data, bytes);
+    };
+
+    double tParse = 1e30, tCache = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        for (const MeshFiles& files : meshes) {
+            vector<VertexData> vertices;
+            vector<TriData> faces;
+            readPLYFile(files.ply, vertices, faces);
+            unsigned char* pixels = nullptr;
+            unsigned int width = 0, height = 0;
+            loadARGB_BMP(files.bmp.c_str(), &pixels, &width, &height);
+            upload(vertices.data(), vertices.size() * sizeof(VertexData));
+            upload(faces.data(), faces.size() * sizeof(TriData));
+            upload(pixels, (size_t)width * height * 4);
+            delete[] pixels;
+        }
+        auto mid = chrono::steady_clock::now();
+        for (const MeshFiles& files : meshes) {
+            CookedMesh mesh;
+            loadCookedMesh(files, mesh);
+            upload(mesh.vertices(), mesh.vertexCount() * sizeof(VertexData));
+            upload(mesh.faces(), mesh.faceCount() * sizeof(TriData));
+            upload(mesh.levelPixels(0), (size_t)mesh.levelWidth(0) * mesh.levelHeight(0) * 4);
+        }
+        auto end = chrono::steady_clock::now();
+        tParse = min(tParse, chrono::duration<double, milli>(mid - start).count());
+        tCache = min(tCache, chrono::duration<double, milli>(end - mid).count());
+    }
+    printf("%-12s %2zu meshes  parse ply+bmp %7.3f ms  mapped cache %7.3f ms (%.1fx)\n",
+        label, meshes.size(), tParse, tCache, tParse / tCache);
+}
+
+// Time for AssetLoader to hand over every mesh in the folders, with the
+// caches missing (parse and cook) and present (map)
+void benchParallelLoad(const vector<string>& dirs, int runs)
+{
+    vector<MeshFiles> meshes;
+    for (const string& dir : dirs) {
+        vector<MeshFiles> found = findMeshFiles(dir);
+        meshes.insert(meshes.end(), found.begin(), found.end());
+    }
+    if (meshes.empty()) return;
+
+    auto loadAll = [&](unsigned threads, bool cold) {
+        double best = 1e30;
+        for (int r = 0; r < runs; r++) {
+            if (cold) {
+                for (const MeshFiles& files : meshes)
+                    remove(meshCachePath(files).c_str());
+            }
+            auto start = chrono::steady_clock::now();
+            AssetLoader loader(meshes, threads);
+            LoadedMesh loaded;
+            while (!loader.done()) {
+                if (!loader.poll(loaded)) this_thread::yield();
+            }
+            best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    };
+
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    printf("%zu meshes, %u hardware threads\n", meshes.size(), cores);
+    double coldOne = loadAll(1, true), warmOne = loadAll(1, false);
+    vector<unsigned> counts = {1, 2, 4};
+    if (cores > 4) counts.push_back(cores);
+    for (unsigned threads : counts) {
+        double cold = threads == 1 ? coldOne : loadAll(threads, true);
+        double warm = threads == 1 ? warmOne : loadAll(threads, false);
+        printf("  %2u threads  no cache %7.2f ms (%.2fx)  cached %7.2f ms (%.2fx)\n",
+            threads, cold, coldOne / cold, warm, warmOne / warm);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int runs = argc > 1 ? atoi(argv[1]) : 5;
+    int repeats = argc > 2 ? atoi(argv[2]) : 20;
+
+    // Times are per load of the whole set. The files are small, so each run
+    // loads them `repeats` times and they stay in the OS file cache.
+    benchSet("LinksHouse", "./LinksHouse", runs, repeats);
+    benchSet("A6 Assets", "../Assignment6/Assets", runs, repeats);
+
+    benchBinary("LinksHouse", "./LinksHouse", runs, repeats);
+    benchBinary("A6 Assets", "../Assignment6/Assets", runs, repeats);
+    benchLargeMesh(1000, runs);
+
+    benchCache("LinksHouse", "./LinksHouse", runs);
+    benchCache("A6 Assets", "../Assignment6/Assets", runs);
+
+    benchParallelLoad({"./LinksHouse", "../Assignment6/Assets"}, runs);
+    return 0;
+}
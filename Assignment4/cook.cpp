@@ -0,0 +1,49 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+
+using namespace std;
+
+// Cooks every ply/bmp pair in a folder into its cache file, so the renderer
+// starts without parsing anything. Up to date caches are left alone unless
+// -f is given.
+//
+//   ./cook.exe [-f] [DIR]      DIR defaults to ./LinksHouse
+int main(int argc, char** argv)
+{
+    bool force = false;
+    string dir = "./LinksHouse";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0) force = true;
+        else dir = argv[i];
+    }
+
+    vector<MeshFiles> meshes = findMeshFiles(dir);
+    if (meshes.empty()) {
+        fprintf(stderr, "No ply/bmp pairs in %s\n", dir.c_str());
+        return 1;
+    }
+
+    int failed = 0;
+    auto start = chrono::steady_clock::now();
+    for (const MeshFiles& files : meshes) {
+        if (!force && meshCacheIsCurrent(files)) {
+            printf("up to date  %s\n", meshCachePath(files).c_str());
+            continue;
+        }
+        if (cookMesh(files)) {
+            printf("cooked      %s\n", meshCachePath(files).c_str());
+        }
+        else {
+            printf("FAILED      %s\n", files.ply.c_str());
+            failed++;
+        }
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    printf("%zu meshes in %.1f ms\n", meshes.size(), ms);
+    return failed ? 1 : 0;
+}
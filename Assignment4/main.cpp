@@ -13,7 +13,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "LoadBitmap.h"
+#include "PLYReader.h"
+#include "MeshCache.h"
+#include "AssetLoader.h"
+#include "ShaderProgram.hpp"
 
 using namespace std;
 using namespace glm;
@@ -28,96 +31,38 @@ vec3 camUp = vec3(0.0f, 1.0f, 0.0f);
 
 string PATH = "./LinksHouse";
 
-struct VertexData
+// Uploads the texture with the mip chain cooked into the cache
+GLuint uploadTexture(const CookedMesh &mesh)
 {
-    float x, y, z;
-    float nx, ny, nz;
-    float r, g, b;
-    float u, v;
-};
-
-struct TriData
-{
-    int indices[3];
-};
-
-void readPLYFile(string fname, vector<VertexData> &vertices, vector<TriData> &faces)
-{
-    ifstream file(fname);
-    string line;
-    int vertexCount = 0;
-    int faceCount = 0;
-
-    while (getline(file, line))
-    {
-        if (line.rfind("element vertex", 0) == 0)
-        {
-            vertexCount = stoi(line.substr(15));
-        }
-        else if (line.rfind("element face", 0) == 0)
-        {
-            faceCount = stoi(line.substr(13));
-        }
-        else if (line == "end_header")
-        {
-            break;
-        }
-    }
-
-    for (int i = 0; i < vertexCount; i++)
-    {
-        VertexData v = {};
-
-        file >> v.x >> v.y >> v.z >> v.nx >> v.ny >> v.nz >> v.u >> v.v;
-
-        v.r = 1.0f; // White color by default
-        v.g = 1.0f;
-        v.b = 1.0f;
-
-        vertices.push_back(v);
-    }
-
-    for (int i = 0; i < faceCount; i++)
-    {
-        int n, v1, v2, v3;
-        file >> n >> v1 >> v2 >> v3;
-        faces.push_back({v1, v2, v3});
-    }
-}
-
-GLuint loadTexture(const string &fname)
-{
-    unsigned char *imgData;
-    unsigned int width, height;
-    loadARGB_BMP(fname.c_str(), &imgData, &width, &height);
-
     GLuint textureID;
 
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_2D, textureID);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, imgData);
+    for (int level = 0; level < mesh.levelCount(); level++)
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, mesh.levelWidth(level), mesh.levelHeight(level), 0,
+                     GL_BGRA, GL_UNSIGNED_BYTE, mesh.levelPixels(level));
+    }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mesh.levelCount() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    delete[] imgData;
     return textureID;
 }
 
-GLuint loadShader()
-{
-
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-
-    string vertexShaderSource = R"(
+// The one program every TexturedMesh draws with
+const char *vertexShaderSource = R"(
         #version 330 core
         layout (location = 0) in vec3 aPos;
         layout (location = 1) in vec3 aNormal;
         layout (location = 3) in vec2 aTexCoord;
         
-        uniform mat4 MVP;
+        // Same for every mesh, updated once per frame
+        layout(std140) uniform Frame {
+            mat4 MVP;
+        };
         
         out vec2 TexCoord;
         
@@ -127,7 +72,7 @@ GLuint loadShader()
         }
         )";
 
-    string fragmentShaderSource = R"(
+const char *fragmentShaderSource = R"(
         #version 330 core
         out vec4 FragColor;
         
@@ -140,76 +85,84 @@ GLuint loadShader()
         }
         )";
 
-    // Compile Vertex Shader
-    const char *vertexShaderSourcePointer = vertexShaderSource.c_str();
-    const char *fragmentShaderSourcePointer = fragmentShaderSource.c_str();
+// std140 mirror of the Frame block in vertexShaderSource
+struct FrameUniforms
+{
+    mat4 MVP;
+};
 
-    glShaderSource(vertexShader, 1, &vertexShaderSourcePointer, NULL);
-    glCompileShader(vertexShader);
+const GLuint FRAME_BINDING = 0;
 
-    // Check Vertex Shader Compilation
-    GLint success;
-    GLchar infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        printf("ERROR: Vertex Shader Compilation Failed\n %s", infoLog);
-    }
+ShaderCache shaders;
 
-    // Compile Fragment Shader
-    glShaderSource(fragmentShader, 1, &fragmentShaderSourcePointer, NULL);
-    glCompileShader(fragmentShader);
+// Built and bound to the Frame block the first time, shared after that
+const ShaderProgram *texturedShader()
+{
+    bool built = false;
+    const ShaderProgram *program = shaders.get(vertexShaderSource, fragmentShaderSource, &built);
+    if (built && program)
+        program->bindBlock("Frame", FRAME_BINDING);
+    return program;
+}
+
+// Owns its buffers, vertex array and texture and deletes them when it goes
+// away, so it can be moved (into a vector) but not copied. The program is
+// shared and belongs to the shader cache.
+class TexturedMesh
+{
+public:
+    GLuint VBO = 0, VAO = 0, EBO = 0, textureID = 0;
+    GLsizei indexCount = 0;
+    const ShaderProgram *shader = nullptr;
 
-    // Check Fragment Shader Compilation
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    // The arrays and pixels go straight from the (usually memory mapped)
+    // cache to GL and are not kept
+    TexturedMesh(const CookedMesh &mesh, const ShaderProgram *program) : shader(program)
     {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        printf("ERROR: Fragment Shader Compilation Failed\n %s", infoLog);
-        return 0;
+        textureID = uploadTexture(mesh);
+        setupMesh(mesh);
     }
 
-    // Link Shaders into a Program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    // Check Program Linking
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success)
+    ~TexturedMesh()
     {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR: Shader Program Linking Failed\n"
-                  << infoLog << std::endl;
-        return 0;
+        release();
     }
 
-    // Clean up shaders after linking
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return shaderProgram;
-}
+    TexturedMesh(const TexturedMesh &) = delete;
+    TexturedMesh &operator=(const TexturedMesh &) = delete;
 
-class TexturedMesh
-{
-public:
-    GLuint VBO, VAO, EBO, textureID, shaderProgram;
-    vector<VertexData> vertices;
-    vector<TriData> faces;
+    TexturedMesh(TexturedMesh &&other) noexcept
+    {
+        take(other);
+    }
 
-    TexturedMesh(const string &plyFile, const string &bmpFile)
+    TexturedMesh &operator=(TexturedMesh &&other) noexcept
     {
+        if (this != &other)
+        {
+            release();
+            take(other);
+        }
+        return *this;
+    }
 
-        readPLYFile(plyFile, vertices, faces);
-        textureID = loadTexture(bmpFile);
-        shaderProgram = loadShader();
-        setupMesh();
+    // Needs the GL context, so meshes have to go before glfwTerminate
+    void release()
+    {
+        if (VAO)
+            glDeleteVertexArrays(1, &VAO);
+        if (VBO)
+            glDeleteBuffers(1, &VBO);
+        if (EBO)
+            glDeleteBuffers(1, &EBO);
+        if (textureID)
+            glDeleteTextures(1, &textureID);
+
+        VAO = VBO = EBO = textureID = 0;
+        indexCount = 0;
     }
 
-    void setupMesh()
+    void setupMesh(const CookedMesh &mesh)
     {
 
         glGenVertexArrays(1, &VAO);
@@ -218,10 +171,11 @@ public:
 
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexData), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount() * sizeof(VertexData), mesh.vertices(), GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(TriData), &faces[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.faceCount() * sizeof(TriData), mesh.faces(), GL_STATIC_DRAW);
+        indexCount = mesh.faceCount() * 3;
 
         GLsizei stride = sizeof(VertexData);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
@@ -239,19 +193,33 @@ public:
         glBindVertexArray(0);
     }
 
-    void draw(glm::mat4 MVP)
+    // The MVP comes from the Frame uniform buffer
+    void draw()
     {
+        if (!shader || !VAO)
+            return;
 
-        glUseProgram(shaderProgram);
-
-        GLuint MVP_Location = glGetUniformLocation(shaderProgram, "MVP");
-        glUniformMatrix4fv(MVP_Location, 1, GL_FALSE, glm::value_ptr(MVP));
+        shader->use();
 
         glBindVertexArray(VAO);
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glDrawElements(GL_TRIANGLES, faces.size() * 3, GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
     }
+
+private:
+    void take(TexturedMesh &other)
+    {
+        VBO = other.VBO;
+        VAO = other.VAO;
+        EBO = other.EBO;
+        textureID = other.textureID;
+        indexCount = other.indexCount;
+        shader = other.shader;
+
+        other.VBO = other.VAO = other.EBO = other.textureID = 0;
+        other.indexCount = 0;
+    }
 };
 
 void processInput(GLFWwindow *window)
@@ -280,39 +248,58 @@ void processInput(GLFWwindow *window)
 
 vector<TexturedMesh> opaque;
 vector<TexturedMesh> trans;
+vector<size_t> transOrder; // loader index of each trans mesh, to draw them in a fixed order
+
+unique_ptr<AssetLoader> loader;
+chrono::steady_clock::time_point loadStart;
 
+// Starts loading every mesh on worker threads. They are uploaded by
+// uploadMeshes as they finish, so the scene fills in over the first frames.
 void setMesh()
 {
-    vector<string> bmp;
-    vector<string> ply;
+    loadStart = chrono::steady_clock::now();
+    loader.reset(new AssetLoader(findMeshFiles(PATH)));
+}
+
+// Uploads finished meshes until budgetMs has passed, at least one per call
+void uploadMeshes(double budgetMs)
+{
+    if (!loader)
+        return;
 
     vector<string> transObjs = {"curtains.bmp", "Curtains.ply", "doorbg.bmp", "DoorBG.ply", "metalobjects.bmp", "MetalObjects.ply"};
 
-    for (const auto &file : directory_iterator(PATH))
+    auto start = chrono::steady_clock::now();
+    LoadedMesh loaded;
+    while (loader->poll(loaded))
     {
-        if (!file.is_regular_file())
-            continue;
+        if (loaded.mesh)
+        {
+            bool isTransPLY = find(transObjs.begin(), transObjs.end(), path(loaded.files.ply).filename().string()) != transObjs.end();
+            bool isTransBMP = find(transObjs.begin(), transObjs.end(), path(loaded.files.bmp).filename().string()) != transObjs.end();
+
+            if (isTransPLY && isTransBMP)
+            {
+                size_t at = upper_bound(transOrder.begin(), transOrder.end(), loaded.index) - transOrder.begin();
+                transOrder.insert(transOrder.begin() + at, loaded.index);
+                trans.insert(trans.begin() + at, TexturedMesh(*loaded.mesh, texturedShader()));
+            }
+            else
+            {
+                opaque.emplace_back(*loaded.mesh, texturedShader());
+            }
+        }
+        loaded.mesh.reset();
 
-        if (file.path().extension() == ".bmp")
-            bmp.push_back(file.path().string());
-        if (file.path().extension() == ".ply")
-            ply.push_back(file.path().string());
+        if (chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() > budgetMs)
+            break;
     }
 
-    size_t numFiles = bmp.size();
-    for (size_t i = 0; i < numFiles; i++)
+    if (loader->done())
     {
-
-        bool isTransPLY = find(transObjs.begin(), transObjs.end(), path(ply[i]).filename().string()) != transObjs.end();
-        bool isTransBMP = find(transObjs.begin(), transObjs.end(), path(bmp[i]).filename().string()) != transObjs.end();
-
-        if (isTransPLY && isTransBMP)
-        {
-            trans.push_back(TexturedMesh(ply[i], bmp[i]));
-            continue;
-        }
-
-        opaque.push_back(TexturedMesh(ply[i], bmp[i]));
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - loadStart).count();
+        printf("Loaded %zu meshes in %.1f ms, %zu shader program(s)\n", opaque.size() + trans.size(), ms, shaders.size());
+        loader.reset();
     }
 }
 
@@ -340,6 +327,10 @@ int main(int argc, char **argv)
 
     setMesh();
 
+    // One uniform buffer update per frame instead of one glUniform per mesh
+    UniformBuffer frameBlock;
+    frameBlock.create(sizeof(FrameUniforms), FRAME_BINDING);
+
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 
     glEnable(GL_BLEND);
@@ -349,6 +340,9 @@ int main(int argc, char **argv)
     {
         glfwPollEvents();
 
+        // A few milliseconds of uploads per frame while the scene streams in
+        uploadMeshes(4.0);
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         processInput(window);
@@ -358,17 +352,18 @@ int main(int argc, char **argv)
 
         mat4 view = lookAt(camPos, camPos + camFront, camUp);
         mat4 MVP = projection * view * model;
+        frameBlock.update(FrameUniforms{MVP});
 
         for (auto &mesh : opaque)
         {
-            mesh.draw(MVP);
+            mesh.draw();
         }
 
         glDepthMask(GL_FALSE);
 
         for (auto &mesh : trans)
         {
-            mesh.draw(MVP);
+            mesh.draw();
         }
 
         glDepthMask(GL_TRUE);
@@ -376,6 +371,12 @@ int main(int argc, char **argv)
         glfwSwapBuffers(window);
     }
 
+    // GL objects go while the context is still alive
+    loader.reset();
+    opaque.clear();
+    trans.clear();
+    shaders.release();
+    frameBlock.release();
     glfwTerminate();
     return 0;
 }
@@ -1,4 +1,14 @@
-int marching_cubes_lut[256][16] =
+// Marching cubes lookup tables. Everything here is constexpr: the classic
+// table below is only read at compile time, to build the compact table the
+// extractors use.
+#ifndef TRI_TABLE_HPP
+#define TRI_TABLE_HPP
+
+#include <cstdint>
+
+// The classic table (Paul Bourke's): for each of the 256 corner cases, up to 5
+// triangles as triples of cube edges, ended by -1
+constexpr int8_t marching_cubes_lut[256][16] =
 {{-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 {0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 {0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
@@ -257,18 +267,75 @@ int marching_cubes_lut[256][16] =
 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}
 };
 
+// Corners joined by each cube edge, with the corner nearer the cell origin
+// first. Corners 0-3 are (0,0,0), (1,0,0), (1,1,0), (0,1,0) and corners 4-7
+// are the same at z + 1.
+constexpr int8_t edgeVertices[12][2] = {
+	{0, 1},
+	{1, 2},
+	{3, 2},
+	{0, 3},
+	{4, 5},
+	{5, 6},
+	{7, 6},
+	{4, 7},
+	{0, 4},
+	{1, 5},
+	{2, 6},
+	{3, 7},
+};
+
+constexpr int count_lut_entries() {
+	int n = 0;
+	for (int c = 0; c < 256; c++)
+		for (int i = 0; i < 16 && marching_cubes_lut[c][i] != -1; i++)
+			n++;
+	return n;
+}
+
+// 820 triangles over all cases
+constexpr int MC_LUT_ENTRIES = count_lut_entries();
 
-float vertTable[12][3] = {
-	{0.5f, 0.0f, 0.0f},
-	{1.0f, 0.0f, 0.5f},
-	{0.5f, 0.0f, 1.0f},
-	{0.0f, 0.0f, 0.5f},
-	{0.5f, 1.0f, 0.0f},
-	{1.0f, 1.0f, 0.5f},
-	{0.5f, 1.0f, 1.0f},
-	{0.0f, 1.0f, 0.5f},
-	{0.0f, 0.5f, 0.0f},
-	{1.0f, 0.5f, 0.0f},
-	{1.0f, 0.5f, 1.0f},
-	{0.0f, 0.5f, 1.0f},
+// The classic table packed without sentinels, about 3.7 KB instead of 16 KB
+// of ints. Case c has triangleCount[c] triangles whose edges are
+// edges[offset[c]] onwards, 3 per triangle. Our corners swap y and z
+// relative to the classic table, which mirrors the winding, so each
+// triangle's edges are stored as 0, 2, 1 to keep the front faces pointing
+// towards values above the isovalue. edgeMask[c] has bit e set if the
+// surface crosses edge e, so each crossing can be interpolated once per cell.
+struct MarchingCubesTables {
+	uint8_t triangleCount[256];
+	uint16_t edgeMask[256];
+	uint16_t offset[256];
+	int8_t edges[MC_LUT_ENTRIES];
 };
+
+constexpr MarchingCubesTables build_mc_tables() {
+	MarchingCubesTables t = {};
+	int next = 0;
+	for (int c = 0; c < 256; c++) {
+		const int8_t* e = marching_cubes_lut[c];
+		int n = 0;
+		while (n < 16 && e[n] != -1)
+			n++;
+
+		t.triangleCount[c] = (uint8_t)(n / 3);
+		t.offset[c] = (uint16_t)next;
+		for (int i = 0; i < n; i += 3) {
+			t.edges[next++] = e[i];
+			t.edges[next++] = e[i + 2];
+			t.edges[next++] = e[i + 1];
+			for (int j = 0; j < 3; j++)
+				t.edgeMask[c] |= (uint16_t)(1 << e[i + j]);
+		}
+	}
+	return t;
+}
+
+inline constexpr MarchingCubesTables mcTables = build_mc_tables();
+
+static_assert(MC_LUT_ENTRIES == 2460, "marching cubes table has 820 triangles");
+static_assert(mcTables.triangleCount[0] == 0 && mcTables.triangleCount[255] == 0, "empty and full cubes have no triangles");
+static_assert(mcTables.edgeMask[1] == 0x109, "case 1 crosses edges 0, 3 and 8");
+
+#endif
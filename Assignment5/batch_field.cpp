@@ -0,0 +1,168 @@
+#include "batch_field.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_FIELD_X86 1
+#include <immintrin.h>
+#endif
+
+// Constants for the Cephes style sincos: range reduce by pi/4 in three parts,
+// then pick the sin or cos polynomial depending on the octant
+static const float FOUR_OVER_PI = 1.27323954473516f;
+static const float DP1 = -0.78515625f;
+static const float DP2 = -2.4187564849853515625e-4f;
+static const float DP3 = -3.77489497744594108e-8f;
+static const float SIN_P0 = -1.9515295891e-4f;
+static const float SIN_P1 = 8.3321608736e-3f;
+static const float SIN_P2 = -1.6666654611e-1f;
+static const float COS_P0 = 2.443315711809948e-5f;
+static const float COS_P1 = -1.388731625493765e-3f;
+static const float COS_P2 = 4.166664568298827e-2f;
+
+static void sineCosineScalar(const float* x, const float* y, const float* z, float* out, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        out[i] = y[i] - std::sin(x[i]) * std::cos(z[i]);
+}
+
+#ifdef BATCH_FIELD_X86
+
+// 4 wide sin(x) and cos(x), SSE2 only
+static inline void sincos4(__m128 x, __m128* s, __m128* c) {
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+    __m128 signSin = _mm_and_ps(x, signMask);
+    x = _mm_andnot_ps(signMask, x);
+
+    // Octant, rounded up to even
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(FOUR_OVER_PI)));
+    j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(j);
+
+    __m128 swapSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+    __m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+    __m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+    signSin = _mm_xor_ps(signSin, swapSin);
+
+    x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP1)));
+    x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP2)));
+    x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP3)));
+    __m128 zz = _mm_mul_ps(x, x);
+
+    __m128 pc = _mm_set1_ps(COS_P0);
+    pc = _mm_add_ps(_mm_mul_ps(pc, zz), _mm_set1_ps(COS_P1));
+    pc = _mm_add_ps(_mm_mul_ps(pc, zz), _mm_set1_ps(COS_P2));
+    pc = _mm_mul_ps(_mm_mul_ps(pc, zz), zz);
+    pc = _mm_sub_ps(pc, _mm_mul_ps(zz, _mm_set1_ps(0.5f)));
+    pc = _mm_add_ps(pc, _mm_set1_ps(1.0f));
+
+    __m128 ps = _mm_set1_ps(SIN_P0);
+    ps = _mm_add_ps(_mm_mul_ps(ps, zz), _mm_set1_ps(SIN_P1));
+    ps = _mm_add_ps(_mm_mul_ps(ps, zz), _mm_set1_ps(SIN_P2));
+    ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, zz), x), x);
+
+    __m128 sinv = _mm_or_ps(_mm_and_ps(polyMask, ps), _mm_andnot_ps(polyMask, pc));
+    __m128 cosv = _mm_or_ps(_mm_and_ps(polyMask, pc), _mm_andnot_ps(polyMask, ps));
+    *s = _mm_xor_ps(sinv, signSin);
+    *c = _mm_xor_ps(cosv, signCos);
+}
+
+static void sineCosineSSE2(const float* x, const float* y, const float* z, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 sx, cx, sz, cz;
+        sincos4(_mm_loadu_ps(x + i), &sx, &cx);
+        sincos4(_mm_loadu_ps(z + i), &sz, &cz);
+        _mm_storeu_ps(out + i, _mm_sub_ps(_mm_loadu_ps(y + i), _mm_mul_ps(sx, cz)));
+    }
+    sineCosineScalar(x + i, y + i, z + i, out + i, n - i);
+}
+
+// 8 wide version of sincos4
+__attribute__((target("avx2,fma")))
+static inline void sincos8(__m256 x, __m256* s, __m256* c) {
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+
+    __m256 signSin = _mm256_and_ps(x, signMask);
+    x = _mm256_andnot_ps(signMask, x);
+
+    __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(FOUR_OVER_PI)));
+    j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+    __m256 y = _mm256_cvtepi32_ps(j);
+
+    __m256 swapSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29));
+    __m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+    __m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+    signSin = _mm256_xor_ps(signSin, swapSin);
+
+    x = _mm256_fmadd_ps(y, _mm256_set1_ps(DP1), x);
+    x = _mm256_fmadd_ps(y, _mm256_set1_ps(DP2), x);
+    x = _mm256_fmadd_ps(y, _mm256_set1_ps(DP3), x);
+    __m256 zz = _mm256_mul_ps(x, x);
+
+    __m256 pc = _mm256_set1_ps(COS_P0);
+    pc = _mm256_fmadd_ps(pc, zz, _mm256_set1_ps(COS_P1));
+    pc = _mm256_fmadd_ps(pc, zz, _mm256_set1_ps(COS_P2));
+    pc = _mm256_mul_ps(_mm256_mul_ps(pc, zz), zz);
+    pc = _mm256_fnmadd_ps(zz, _mm256_set1_ps(0.5f), pc);
+    pc = _mm256_add_ps(pc, _mm256_set1_ps(1.0f));
+
+    __m256 ps = _mm256_set1_ps(SIN_P0);
+    ps = _mm256_fmadd_ps(ps, zz, _mm256_set1_ps(SIN_P1));
+    ps = _mm256_fmadd_ps(ps, zz, _mm256_set1_ps(SIN_P2));
+    ps = _mm256_fmadd_ps(_mm256_mul_ps(ps, zz), x, x);
+
+    *s = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, polyMask), signSin);
+    *c = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, polyMask), signCos);
+}
+
+__attribute__((target("avx2,fma")))
+static void sineCosineAVX2(const float* x, const float* y, const float* z, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 sx, cx, sz, cz;
+        sincos8(_mm256_loadu_ps(x + i), &sx, &cx);
+        sincos8(_mm256_loadu_ps(z + i), &sz, &cz);
+        _mm256_storeu_ps(out + i, _mm256_fnmadd_ps(sx, cz, _mm256_loadu_ps(y + i)));
+    }
+    sineCosineSSE2(x + i, y + i, z + i, out + i, n - i);
+}
+
+#endif
+
+SimdLevel detectSimdLevel() {
+#ifdef BATCH_FIELD_X86
+    static const SimdLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return SimdLevel::SSE2;
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX2: return "AVX2";
+        case SimdLevel::SSE2: return "SSE2";
+        default: return "scalar";
+    }
+}
+
+SineCosineField::SineCosineField(SimdLevel level) {
+    // Never run code the CPU does not support, even if asked to
+    if (level > detectSimdLevel())
+        level = detectSimdLevel();
+
+    simdLevel = level;
+    batch = sineCosineScalar;
+#ifdef BATCH_FIELD_X86
+    if (level == SimdLevel::AVX2)
+        batch = sineCosineAVX2;
+    else if (level == SimdLevel::SSE2)
+        batch = sineCosineSSE2;
+#endif
+}
@@ -0,0 +1,44 @@
+#ifndef BATCH_FIELD_H
+#define BATCH_FIELD_H
+
+#include <cmath>
+#include <cstddef>
+
+// A field type may provide
+//     void evalBatch(const float* x, const float* y, const float* z, float* out, size_t n) const;
+// next to its scalar operator(). compute_normals_gradient then evaluates each
+// chunk of vertices with one evalBatch call per axis instead of one call per
+// point. The arrays are structure-of-arrays: out[i] = f(x[i], y[i], z[i]).
+// The extractors never use it; they call operator() so they match marching_cubes.
+
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+// Best instruction set this CPU supports, checked once with CPUID
+SimdLevel detectSimdLevel();
+const char* simdLevelName(SimdLevel level);
+
+// The y - sin(x) * cos(z) surface from main.cpp. The SSE2/AVX2 batches use a
+// polynomial sincos that is accurate to a few float ulps, so they can differ
+// from operator() in the last bits.
+class SineCosineField {
+public:
+    typedef void (*BatchFn)(const float* x, const float* y, const float* z, float* out, size_t n);
+
+    explicit SineCosineField(SimdLevel level = detectSimdLevel());
+
+    float operator()(float x, float y, float z) const {
+        return y - std::sin(x) * std::cos(z);
+    }
+
+    void evalBatch(const float* x, const float* y, const float* z, float* out, size_t n) const {
+        batch(x, y, z, out, n);
+    }
+
+    SimdLevel level() const { return simdLevel; }
+
+private:
+    SimdLevel simdLevel;
+    BatchFn batch;
+};
+
+#endif
@@ -0,0 +1,600 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <array>
+
+#include "marching_cubes.h"
+#include "batch_field.h"
+#include "sampled_grid.h"
+#include "dual_contouring.h"
+#include "lod.h"
+#include "simplify.h"
+#include "volume.h"
+#include "incremental.h"
+#include "ply_writer.h"
+
+using namespace std;
+
+// Time fn over a few runs and return the best time in milliseconds
+template <typename Fn>
+double bestOf(int runs, Fn fn, size_t& outSize) {
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        outSize = fn().size();
+        auto end = chrono::steady_clock::now();
+        best = std::min(best, chrono::duration<double, milli>(end - start).count());
+    }
+    return best;
+}
+
+void benchFieldCall(float stepsize, int runs) {
+    float isovalue = 0.0f, min = -1.5f, max = 1.5f;
+
+    auto field = [](float x, float y, float z) {
+        return y - sin(x) * cos(z);
+    };
+    function<float(float, float, float)> wrapped = field;
+
+    size_t n1 = 0, n2 = 0, n3 = 0, n4 = 0;
+    double tFunction = bestOf(runs, [&]() { return marching_cubes(wrapped, isovalue, min, max, stepsize); }, n1);
+    double tTemplate = bestOf(runs, [&]() { return marching_cubes(field, isovalue, min, max, stepsize); }, n2);
+    double tFunctionCached = bestOf(runs, [&]() { return marching_cubes_cached(wrapped, isovalue, min, max, stepsize); }, n3);
+    double tTemplateCached = bestOf(runs, [&]() { return marching_cubes_cached(field, isovalue, min, max, stepsize); }, n4);
+
+    int cells = (int)((max - min) / stepsize);
+    printf("%4d^3  marching_cubes: std::function %8.2f ms  template %8.2f ms  (%.2fx)\n",
+        cells, tFunction, tTemplate, tFunction / tTemplate);
+    printf("%4d^3  cached:         std::function %8.2f ms  template %8.2f ms  (%.2fx)\n",
+        cells, tFunctionCached, tTemplateCached, tFunctionCached / tTemplateCached);
+
+    if (n1 != n2 || n3 != n4)
+        printf("  output size mismatch: %zu %zu %zu %zu\n", n1, n2, n3, n4);
+}
+
+// marching_cubes_parallel has to give exactly the bytes of marching_cubes
+// for any thread count, so uneven slabs are checked too (3 and 7 threads)
+void checkParallel(const vector<float>& stepsizes) {
+    float isovalue = 0.0f, min = -1.5f, max = 1.5f;
+
+    auto field = [](float x, float y, float z) {
+        return y - sin(x) * cos(z);
+    };
+
+    unsigned hc = std::max(1u, thread::hardware_concurrency());
+    for (float stepsize : stepsizes) {
+        vector<float> serial = marching_cubes(field, isovalue, min, max, stepsize);
+        int cells = (int)((max - min) / stepsize);
+
+        bool same = true;
+        for (unsigned threads : {2u, 3u, 7u, hc}) {
+            vector<float> parallel = marching_cubes_parallel(field, isovalue, min, max, stepsize, threads);
+            if (parallel.size() != serial.size()
+                || memcmp(parallel.data(), serial.data(), serial.size() * sizeof(float)) != 0) {
+                printf("%4d^3  MISMATCH: marching_cubes_parallel with %u threads differs from marching_cubes\n", cells, threads);
+                same = false;
+            }
+        }
+        if (same)
+            printf("%4d^3  parallel output identical to marching_cubes with 2, 3, 7 and %u threads\n", cells, hc);
+    }
+}
+
+// marching_cubes_indexed expanded through its indices has to be the same
+// soup as marching_cubes, with the same triangles in the same order
+void checkIndexed(const vector<float>& stepsizes) {
+    float isovalue = 0.0f, min = -1.5f, max = 1.5f;
+
+    auto field = [](float x, float y, float z) {
+        return y - sin(x) * cos(z);
+    };
+
+    for (float stepsize : stepsizes) {
+        vector<float> soup = marching_cubes(field, isovalue, min, max, stepsize);
+        IndexedMesh mesh = marching_cubes_indexed(field, isovalue, min, max, stepsize);
+        int cells = (int)((max - min) / stepsize);
+
+        vector<float> expanded;
+        expanded.reserve(mesh.indices.size() * 3);
+        for (uint32_t index : mesh.indices)
+            expanded.insert(expanded.end(), &mesh.vertices[index * 3], &mesh.vertices[index * 3] + 3);
+
+        if (expanded.size() != soup.size()
+            || memcmp(expanded.data(), soup.data(), soup.size() * sizeof(float)) != 0)
+            printf("%4d^3  MISMATCH: marching_cubes_indexed differs from marching_cubes\n", cells);
+        else
+            printf("%4d^3  indexed output identical to marching_cubes (%zu vertices for %zu triangles)\n",
+                cells, mesh.vertices.size() / 3, mesh.indices.size() / 3);
+    }
+}
+
+// One thread against every core on the same grid
+void benchParallel(float stepsize, int runs) {
+    float isovalue = 0.0f, min = -1.5f, max = 1.5f;
+
+    auto field = [](float x, float y, float z) {
+        return y - sin(x) * cos(z);
+    };
+
+    unsigned hc = std::max(1u, thread::hardware_concurrency());
+    size_t n1 = 0, n2 = 0;
+    double tOne = bestOf(runs, [&]() { return marching_cubes_parallel(field, isovalue, min, max, stepsize, 1); }, n1);
+    double tAll = bestOf(runs, [&]() { return marching_cubes_parallel(field, isovalue, min, max, stepsize, hc); }, n2);
+
+    int cells = (int)((max - min) / stepsize);
+    printf("%4d^3  parallel: 1 thread %8.2f ms  %u threads %8.2f ms  (%.2fx)\n", cells, tOne, hc, tAll, tOne / tAll);
+
+    if (n1 != n2)
+        printf("  output size mismatch: %zu %zu\n", n1, n2);
+}
+
+// Field evaluation alone over an n^3 lattice, one row at a time
+void benchBatchSampling(int n, int runs) {
+    vector<float> xs(n), ys(n), zs(n), out(n);
+    for (int i = 0; i < n; i++)
+        xs[i] = -1.5f + 3.0f * i / (n - 1);
+
+    auto field = [](float x, float y, float z) {
+        return y - sin(x) * cos(z);
+    };
+
+    size_t size = 0;
+    double tLambda = bestOf(runs, [&]() {
+        for (int k = 0; k < n; k++)
+            for (int j = 0; j < n; j++)
+                for (int i = 0; i < n; i++)
+                    out[i] = field(xs[i], xs[j], xs[k]);
+        return out;
+    }, size);
+    printf("%4d^3  sampling lambda        %8.2f ms\n", n, tLambda);
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2}) {
+        SineCosineField batch(level);
+        if (batch.level() != level) continue;
+
+        double t = bestOf(runs, [&]() {
+            for (int k = 0; k < n; k++) {
+                fill(zs.begin(), zs.end(), xs[k]);
+                for (int j = 0; j < n; j++) {
+                    fill(ys.begin(), ys.end(), xs[j]);
+                    batch.evalBatch(xs.data(), ys.data(), zs.data(), out.data(), n);
+                }
+            }
+            return out;
+        }, size);
+        printf("%4d^3  sampling batch %-6s  %8.2f ms  (%.2fx)\n", n, simdLevelName(level), t, tLambda / t);
+    }
+}
+
+// The extractors ignore evalBatch, so a batch field gives the same bytes as
+// marching_cubes. The batch only pays for the gradient normals.
+void benchBatchField(float stepsize, int runs) {
+    float isovalue = 0.0f, min = -1.5f, max = 1.5f;
+
+    auto field = [](float x, float y, float z) {
+        return y - sin(x) * cos(z);
+    };
+
+    int cells = (int)((max - min) / stepsize);
+    vector<float> vertices = marching_cubes(field, isovalue, min, max, stepsize);
+    float h = stepsize * 0.5f;
+
+    size_t n = 0;
+    double tLambda = bestOf(runs, [&]() { return compute_normals_gradient(field, vertices, h, 1); }, n);
+    printf("%4d^3  gradient normals lambda %8.2f ms\n", cells, tLambda);
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2}) {
+        SineCosineField batch(level);
+        if (batch.level() != level) continue;
+
+        double t = bestOf(runs, [&]() { return compute_normals_gradient(batch, vertices, h, 1); }, n);
+        printf("%4d^3  gradient normals %-6s %8.2f ms  (%.2fx)\n", cells, simdLevelName(level), t, tLambda / t);
+
+        vector<float> cached = marching_cubes_cached(batch, isovalue, min, max, stepsize);
+        if (cached.size() != vertices.size() || memcmp(cached.data(), vertices.data(), vertices.size() * sizeof(float)) != 0)
+            printf("  MISMATCH: cached extraction of the %s field differs from marching_cubes\n", simdLevelName(level));
+    }
+}
+
+// A small sphere in a large box, so most bricks are empty
+void benchBrickCulling(int n, int runs) {
+    Grid grid{-1.5f, -1.5f, -1.5f, 1.5f, 1.5f, 1.5f, n, n, n};
+    SampledGrid volume = sample_grid([](float x, float y, float z) {
+        return sqrt(x * x + y * y + z * z) - 0.4f;
+    }, grid);
+    MinMaxBricks bricks = build_min_max_bricks(volume, 8);
+
+    size_t n1 = 0, n2 = 0;
+    CullStats stats;
+    double tAll = bestOf(runs, [&]() { return marching_cubes_sampled(volume, 0.0f); }, n1);
+    double tBricks = bestOf(runs, [&]() { return marching_cubes_sampled(volume, 0.0f, &bricks, &stats); }, n2);
+
+    printf("%4d^3  sparse sphere: all cells %8.2f ms  8^3 bricks %8.2f ms  (%.2fx)\n", n, tAll, tBricks, tAll / tBricks);
+    printf("        cells visited %zu, skipped %zu; bricks active %zu, skipped %zu\n",
+        stats.cellsVisited, stats.cellsSkipped, stats.bricksActive, stats.bricksSkipped);
+
+    if (n1 != n2)
+        printf("  output size mismatch: %zu %zu\n", n1, n2);
+}
+
+// Writes a sphere as an 8 bit raw file, maps it with RawVolume and checks the
+// extraction against marching_cubes_sampled on the same voxels. 8 bit voxels
+// are whole numbers, so the trilinear weights are exact and so is the match.
+void benchVolume(int n, int runs) {
+    const char* fileName = "benchmark_volume.raw";
+    SampledGrid sampled;
+    sampled.grid = Grid{0.0f, 0.0f, 0.0f, (float)(n - 1), (float)(n - 1), (float)(n - 1), n - 1, n - 1, n - 1};
+    sampled.values.resize((size_t)n * n * n);
+    vector<unsigned char> voxels(sampled.values.size());
+
+    float c = 0.5f * (n - 1);
+    for (int k = 0; k < n; k++) {
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i < n; i++) {
+                float d = sqrtf((i - c) * (i - c) + (j - c) * (j - c) + (k - c) * (k - c)) / c;
+                size_t index = ((size_t)k * n + j) * n + i;
+                voxels[index] = (unsigned char)std::min(255.0f, d * 200.0f);
+                sampled.values[index] = voxels[index];
+            }
+        }
+    }
+
+    FILE* file = fopen(fileName, "wb");
+    if (!file || fwrite(voxels.data(), 1, voxels.size(), file) != voxels.size()) {
+        printf("  cannot write %s\n", fileName);
+        if (file) fclose(file);
+        return;
+    }
+    fclose(file);
+
+    RawVolume volume;
+    if (!volume.open(fileName, n, n, n, VoxelType::UInt8)) {
+        printf("  cannot map %s\n", fileName);
+        remove(fileName);
+        return;
+    }
+
+    size_t n1 = 0, n2 = 0;
+    double tSampled = bestOf(runs, [&]() { return marching_cubes_sampled(sampled, 150.0f); }, n1);
+    double tMapped = bestOf(runs, [&]() { return marching_cubes_volume(volume, 150.0f); }, n2);
+
+    printf("%4d^3  8 bit raw volume: in memory %8.2f ms  mapped %8.2f ms  (%zu triangles)\n",
+        n, tSampled, tMapped, n2 / 9);
+    if (marching_cubes_volume(volume, 150.0f) != marching_cubes_sampled(sampled, 150.0f))
+        printf("  MISMATCH between the mapped volume and the sampled grid\n");
+
+    volume.close();
+    remove(fileName);
+}
+
+// Triangles sorted by their 9 coordinates, so two soups with the same
+// triangles in a different order compare equal
+static vector<array<float, 9>> sortedTriangles(const vector<float>& vertices) {
+    vector<array<float, 9>> tris(vertices.size() / 9);
+    for (size_t t = 0; t < tris.size(); t++)
+        copy(vertices.begin() + t * 9, vertices.begin() + t * 9 + 9, tris[t].begin());
+    sort(tris.begin(), tris.end());
+    return tris;
+}
+
+// Adds a blob inside one 8^3 block of a sphere and compares the incremental
+// update against extracting the edited field from scratch
+void benchIncremental(int n, int runs) {
+    Grid grid{-1.5f, -1.5f, -1.5f, 1.5f, 1.5f, 1.5f, n, n, n};
+    auto sphere = [](float x, float y, float z) {
+        return sqrtf(x * x + y * y + z * z) - 1.0f;
+    };
+
+    // The blob sits on the sphere and fits inside the edit box
+    float h = 3.0f / n;
+    float bx = 1.0f, r = 2.5f * h, box = 4.0f * h;
+    auto edited = [=](float x, float y, float z) {
+        float blob = sqrtf((x - bx) * (x - bx) + y * y + z * z) - r;
+        return std::min(sqrtf(x * x + y * y + z * z) - 1.0f, blob);
+    };
+
+    size_t n1 = 0, n2 = 0, rebuilt = 0;
+    double tFull = bestOf(runs, [&]() {
+        return marching_cubes_sampled(sample_grid(edited, grid), 0.0f);
+    }, n1);
+
+    IncrementalExtractor extractor(sphere, grid, 0.0f);
+    double tEdit = 1e30;
+    for (int i = 0; i < runs; i++) {
+        IncrementalExtractor copy = extractor;
+        auto start = chrono::steady_clock::now();
+        rebuilt = copy.updateRegion(edited, bx - box, -box, -box, bx + box, box, box);
+        auto end = chrono::steady_clock::now();
+        tEdit = std::min(tEdit, chrono::duration<double, milli>(end - start).count());
+        n2 = copy.vertices().size();
+        if (i == 0 && sortedTriangles(copy.vertices()) != sortedTriangles(marching_cubes_sampled(sample_grid(edited, grid), 0.0f)))
+            printf("  MISMATCH between the incremental edit and a full extraction\n");
+    }
+
+    printf("%4d^3  blob edit: full resample + extract %8.2f ms  incremental %8.2f ms  (%zu of %zu blocks, %.1fx)\n",
+        n, tFull, tEdit, rebuilt, extractor.blockCount(), tFull / tEdit);
+
+    if (n1 != n2)
+        printf("  output size mismatch: %zu %zu\n", n1, n2);
+}
+
+// Largest |f| over a few points on every triangle. For a signed distance
+// field that is how far the mesh strays from the true surface.
+template <typename F>
+float meshError(F& f, const IndexedMesh& mesh) {
+    float worst = 0.0f;
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        const float* a = &mesh.vertices[mesh.indices[t] * 3];
+        const float* b = &mesh.vertices[mesh.indices[t + 1] * 3];
+        const float* c = &mesh.vertices[mesh.indices[t + 2] * 3];
+
+        for (int u = 0; u <= 4; u++) {
+            for (int v = 0; u + v <= 4; v++) {
+                float s = u * 0.25f, r = v * 0.25f, w = 1.0f - s - r;
+                float x = w * a[0] + s * b[0] + r * c[0];
+                float y = w * a[1] + s * b[1] + r * c[1];
+                float z = w * a[2] + s * b[2] + r * c[2];
+                worst = std::max(worst, fabsf(f(x, y, z)));
+            }
+        }
+    }
+    return worst;
+}
+
+// A rotated box, which marching cubes can only chamfer. For each dual
+// contouring step size, marching cubes is refined until its error is as low.
+void benchDualContouring(int runs) {
+    float c = cosf(0.5f), s = sinf(0.5f);
+    auto box = [c, s](float x, float y, float z) {
+        float qx = fabsf(c * x - s * z) - 0.8f;
+        float qy = fabsf(y) - 0.6f;
+        float qz = fabsf(s * x + c * z) - 0.7f;
+        float ox = std::max(qx, 0.0f), oy = std::max(qy, 0.0f), oz = std::max(qz, 0.0f);
+        return sqrtf(ox * ox + oy * oy + oz * oz) + std::min(std::max(qx, std::max(qy, qz)), 0.0f);
+    };
+
+    for (float stepsize : {0.2f, 0.1f}) {
+        IndexedMesh dc;
+        size_t n = 0;
+        double tDual = bestOf(runs, [&]() { dc = dual_contouring(box, 0.0f, -1.5f, 1.5f, stepsize); return dc.indices; }, n);
+        float dcError = meshError(box, dc);
+
+        printf("box  dual contouring step %.4f  %7zu tris %8.2f ms  max error %.4f\n",
+            stepsize, dc.indices.size() / 3, tDual, dcError);
+
+        IndexedMesh mc;
+        float mcStep = stepsize, mcError = 1e30f;
+        double tMarch = 0.0;
+        while (mcError > dcError && mcStep > stepsize / 16) {
+            tMarch = bestOf(runs, [&]() { mc = marching_cubes_indexed(box, 0.0f, -1.5f, 1.5f, mcStep); return mc.indices; }, n);
+            mcError = meshError(box, mc);
+            if (mcError > dcError) mcStep *= 0.8f;
+        }
+
+        printf("     marching cubes  step %.4f  %7zu tris %8.2f ms  max error %.4f  (%.1fx tris, %.1fx time)%s\n",
+            mcStep, mc.indices.size() / 3, tMarch, mcError,
+            (double)mc.indices.size() / dc.indices.size(), tMarch / tDual,
+            mcError > dcError ? "  [stopped at 16x finer]" : "");
+    }
+}
+
+// A rolling terrain seen from one corner, uniform grid against chunked LOD
+void benchLOD(int runs) {
+    auto terrain = [](float x, float y, float z) {
+        return y - 0.3f * sinf(1.7f * x) * cosf(1.3f * z) - 0.1f * sinf(4.1f * x + 2.3f * z);
+    };
+
+    Grid grid{-4.0f, -1.0f, -4.0f, 4.0f, 1.0f, 4.0f, 512, 128, 512};
+    glm::vec3 viewPoint(-3.5f, 0.5f, -3.5f);
+
+    size_t n1 = 0, n2 = 0;
+    double tUniform = bestOf(runs, [&]() { return marching_cubes_parallel(terrain, 0.0f, grid, 1); }, n1);
+
+    vector<LODChunk> chunks;
+    double tLOD = bestOf(runs, [&]() {
+        chunks = marching_cubes_lod(terrain, 0.0f, grid, viewPoint);
+        return merge_lod_chunks(chunks);
+    }, n2);
+
+    int perLevel[8] = {0};
+    for (const LODChunk& chunk : chunks)
+        perLevel[chunk.level]++;
+
+    printf("terrain 512x128x512  uniform %8zu tris %8.2f ms\n", n1 / 9, tUniform);
+    printf("                     LOD     %8zu tris %8.2f ms  (%.1f%% of the triangles)  chunks per level %d %d %d %d\n",
+        n2 / 9, tLOD, 100.0 * n2 / n1, perLevel[0], perLevel[1], perLevel[2], perLevel[3]);
+}
+
+// The cell emitter as it was before the compact tables: a 16 KB int table
+// scanned for -1, every triangle corner interpolated on its own and pushed
+// back a float at a time
+static int sentinelTable[256][16];
+
+static void march_cell_sentinel(const glm::vec3 corners[8], const float cubeValues[8], float isovalue, vector<float>& vertices) {
+    int cubeIndex = 0;
+    for (int i = 0; i < 8; ++i)
+        if (cubeValues[i] < isovalue) cubeIndex |= (1 << i);
+    if (cubeIndex == 0 || cubeIndex == 255) return;
+
+    const int* edges = sentinelTable[cubeIndex];
+    for (int i = 0; edges[i] != -1; i += 3) {
+        glm::vec3 p[3];
+        for (int j = 0; j < 3; j++) {
+            int edge = edges[i + j];
+            int v0 = edgeVertices[edge][0];
+            int v1 = edgeVertices[edge][1];
+            p[j] = mc_detail::interpolateVertex(corners[v0], corners[v1], cubeValues[v0], cubeValues[v1], isovalue);
+        }
+        for (int j : {0, 2, 1}) {
+            vertices.push_back(p[j].x);
+            vertices.push_back(p[j].y);
+            vertices.push_back(p[j].z);
+        }
+    }
+}
+
+// Triangle emission alone: every one of the 256 cases once per pass, with
+// the corner values (8 KB) and output buffer staying in L1/L2
+void benchLookupTables(int passes, int runs) {
+    for (int c = 0; c < 256; c++)
+        for (int i = 0; i < 16; i++)
+            sentinelTable[c][i] = marching_cubes_lut[c][i];
+
+    const glm::vec3 corners[8] = {
+        {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+        {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}
+    };
+    vector<float> values(256 * 8);
+    for (int c = 0; c < 256; c++)
+        for (int i = 0; i < 8; i++)
+            values[c * 8 + i] = ((c >> i) & 1) ? -0.3f - 0.05f * i : 0.2f + 0.07f * i;
+
+    vector<float> outSentinel, outCompact;
+    outSentinel.reserve(256 * 45);
+    outCompact.reserve(256 * 45);
+
+    size_t n1 = 0, n2 = 0;
+    double tSentinel = bestOf(runs, [&]() {
+        for (int p = 0; p < passes; p++) {
+            outSentinel.clear();
+            for (int c = 0; c < 256; c++)
+                march_cell_sentinel(corners, &values[c * 8], 0.0f, outSentinel);
+        }
+        return outSentinel;
+    }, n1);
+    double tCompact = bestOf(runs, [&]() {
+        for (int p = 0; p < passes; p++) {
+            outCompact.clear();
+            for (int c = 0; c < 256; c++)
+                mc_detail::march_cell(corners, &values[c * 8], 0.0f, outCompact);
+        }
+        return outCompact;
+    }, n2);
+
+    double cells = 256.0 * passes;
+    printf("lookup tables  sentinel int[256][16] %6.2f ns/cell  compact int8 %6.2f ns/cell  (%.2fx)\n",
+        tSentinel * 1e6 / cells, tCompact * 1e6 / cells, tSentinel / tCompact);
+
+    if (n1 != n2 || outSentinel != outCompact)
+        printf("  output mismatch: %zu %zu\n", n1, n2);
+}
+
+// The body of a PLY file, everything after the header
+static string plyBody(const char* fileName) {
+    string data;
+    FILE* file = fopen(fileName, "rb");
+    if (!file) return data;
+    char buffer[1 << 16];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.append(buffer, n);
+    fclose(file);
+
+    size_t end = data.find("end_header\n");
+    return end == string::npos ? string() : data.substr(end + 11);
+}
+
+// Streams a sphere into a PLY and checks that the vertex and face data is
+// the same as writing the whole soup at once. The headers differ only in the
+// zero padding of the counts. A sink that fails has to stop the extraction.
+void benchStreamExport(float stepsize, int runs) {
+    auto sphere = [](float x, float y, float z) {
+        return sqrtf(x * x + y * y + z * z) - 1.0f;
+    };
+    Grid grid = make_grid(-1.5f, 1.5f, stepsize);
+    const char* streamed = "benchmark_stream.ply";
+    const char* whole = "benchmark_whole.ply";
+
+    size_t n1 = 0, n2 = 0;
+    double tStream = bestOf(runs, [&]() {
+        PLYStreamWriter writer;
+        writer.open(streamed);
+        marching_cubes_stream(sphere, 0.0f, grid, plyStreamSink(writer));
+        writer.close();
+        return vector<float>(writer.triangleCount());
+    }, n1);
+    double tWhole = bestOf(runs, [&]() {
+        vector<float> vertices = marching_cubes(sphere, 0.0f, grid);
+        writePLYBinary(vertices, compute_normals(vertices, 1), whole);
+        return vector<float>(vertices.size() / 9);
+    }, n2);
+
+    printf("%4d^3  PLY export: streamed %8.2f ms  whole mesh %8.2f ms  (%zu triangles)\n", grid.nx, tStream, tWhole, n1);
+
+    string body = plyBody(streamed);
+    if (body.empty() || body != plyBody(whole))
+        printf("  MISMATCH between the streamed and the whole PLY data\n");
+
+    size_t batches = 0;
+    size_t accepted = marching_cubes_stream(sphere, 0.0f, grid, [&](const vector<float>&) {
+        return ++batches < 2;
+    });
+    if (batches != 2)
+        printf("  marching_cubes_stream kept going after the sink failed (%zu batches, %zu triangles)\n", batches, accepted);
+
+    remove(streamed);
+    remove(whole);
+}
+
+// A bumpy sphere on a fine grid, simplified to 10% and 1% of its triangles
+void benchSimplify(float stepsize, int runs) {
+    auto bumpy = [](float x, float y, float z) {
+        return sqrtf(x * x + y * y + z * z) - 1.0f + 0.1f * sinf(5.0f * x) * cosf(4.0f * y);
+    };
+
+    IndexedMesh mesh = marching_cubes_indexed(bumpy, 0.0f, -1.5f, 1.5f, stepsize);
+    size_t before = mesh.indices.size() / 3;
+
+    for (float keep : {0.1f, 0.01f}) {
+        IndexedMesh simple;
+        SimplifyStats stats;
+        size_t n = 0;
+        double t = bestOf(runs, [&]() { simple = simplify_mesh(mesh, keep, &stats); return simple.indices; }, n);
+
+        printf("bumpy sphere %8zu tris -> %7zu (%4.1f%%) %9.2f ms  %.2f M tris/s  max collapse error %.5f  surface error %.5f\n",
+            before, n / 3, 100.0 * keep, t, before / t / 1000.0, stats.maxError, meshError(bumpy, simple));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int runs = argc > 1 ? atoi(argv[1]) : 3;
+
+    benchLookupTables(20000, runs);
+
+    for (float stepsize : {0.05f, 0.025f, 0.0125f})
+        benchFieldCall(stepsize, runs);
+
+    checkParallel({0.1f, 0.05f, 0.025f, 0.0125f});
+    checkIndexed({0.1f, 0.05f, 0.025f, 0.0125f});
+    benchParallel(0.01f, runs);
+
+    benchBatchSampling(241, runs);
+    for (float stepsize : {0.025f, 0.0125f})
+        benchBatchField(stepsize, runs);
+
+    benchBrickCulling(256, runs);
+
+    benchVolume(128, runs);
+
+    benchIncremental(128, runs);
+
+    benchStreamExport(0.01f, runs);
+
+    benchDualContouring(runs);
+
+    benchLOD(runs);
+
+    benchSimplify(0.005f, runs);
+
+    return 0;
+}
+
+// g++ -O2 benchmark.cpp marching_cubes.cpp batch_field.cpp sampled_grid.cpp dual_contouring.cpp lod.cpp simplify.cpp volume.cpp incremental.cpp ply_writer.cpp -o benchmark.exe -lm -lstdc++ -pthread
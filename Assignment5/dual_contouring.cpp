@@ -0,0 +1,205 @@
+#include "dual_contouring.h"
+
+#include <cmath>
+
+using namespace std;
+
+// Relative cutoff for the QEF's eigenvalues. Directions with less than 1% of
+// the strongest one are treated as unconstrained, so a nearly flat cell does
+// not send its vertex far along the surface.
+static const double QEF_EIGEN_CUTOFF = 0.01;
+
+// Sums for the QEF sum((n . (x - p))^2) of one cell
+struct QEF {
+    double ata[6] = {0, 0, 0, 0, 0, 0};  // xx, xy, xz, yy, yz, zz
+    double atb[3] = {0, 0, 0};
+    double mass[3] = {0, 0, 0};
+    int count = 0;
+
+    void add(const HermiteEdge& e) {
+        double n[3] = {e.nx, e.ny, e.nz};
+        double d = n[0] * e.px + n[1] * e.py + n[2] * e.pz;
+
+        ata[0] += n[0] * n[0]; ata[1] += n[0] * n[1]; ata[2] += n[0] * n[2];
+        ata[3] += n[1] * n[1]; ata[4] += n[1] * n[2]; ata[5] += n[2] * n[2];
+        for (int a = 0; a < 3; a++)
+            atb[a] += n[a] * d;
+
+        mass[0] += e.px;
+        mass[1] += e.py;
+        mass[2] += e.pz;
+        count++;
+    }
+};
+
+// Eigen decomposition of a symmetric 3x3 matrix by Jacobi rotations. On
+// return a holds the eigenvalues on its diagonal and v the eigenvectors as columns.
+static void jacobi_eigen(double a[3][3], double v[3][3]) {
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++)
+            v[r][c] = r == c;
+
+    for (int sweep = 0; sweep < 8; sweep++) {
+        double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+        if (off < 1e-20) break;
+
+        for (int p = 0; p < 2; p++) {
+            for (int q = p + 1; q < 3; q++) {
+                if (fabs(a[p][q]) < 1e-30) continue;
+
+                double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                double t = (theta >= 0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+
+                // A = J^T A J, V = V J
+                for (int k = 0; k < 3; k++) {
+                    double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < 3; k++) {
+                    double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < 3; k++) {
+                    double vkp = v[k][p], vkq = v[k][q];
+                    v[k][p] = c * vkp - s * vkq;
+                    v[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+
+// Minimizer of the QEF closest to the mass point, using the pseudo-inverse
+static void solve_qef(const QEF& q, double out[3]) {
+    double m[3] = {q.mass[0] / q.count, q.mass[1] / q.count, q.mass[2] / q.count};
+
+    double a[3][3] = {
+        {q.ata[0], q.ata[1], q.ata[2]},
+        {q.ata[1], q.ata[3], q.ata[4]},
+        {q.ata[2], q.ata[4], q.ata[5]}
+    };
+
+    // Solve A (x - m) = b - A m
+    double r[3];
+    for (int row = 0; row < 3; row++)
+        r[row] = q.atb[row] - (a[row][0] * m[0] + a[row][1] * m[1] + a[row][2] * m[2]);
+
+    double v[3][3];
+    jacobi_eigen(a, v);
+
+    double maxEigen = max({fabs(a[0][0]), fabs(a[1][1]), fabs(a[2][2])});
+    for (int c = 0; c < 3; c++)
+        out[c] = m[c];
+    if (maxEigen <= 0.0) return;
+
+    for (int e = 0; e < 3; e++) {
+        double lambda = a[e][e];
+        if (fabs(lambda) < QEF_EIGEN_CUTOFF * maxEigen) continue;
+
+        double proj = (v[0][e] * r[0] + v[1][e] * r[1] + v[2][e] * r[2]) / lambda;
+        for (int c = 0; c < 3; c++)
+            out[c] += v[c][e] * proj;
+    }
+}
+
+IndexedMesh contour_hermite_edges(const SampledGrid& volume, float isovalue, const vector<HermiteEdge>& edges) {
+    const Grid& g = volume.grid;
+    IndexedMesh mesh;
+    if (volume.values.empty() || edges.empty()) return mesh;
+
+    vector<float> xs = mc_detail::lattice_axis(g.minX, g.maxX, g.nx);
+    vector<float> ys = mc_detail::lattice_axis(g.minY, g.maxY, g.ny);
+    vector<float> zs = mc_detail::lattice_axis(g.minZ, g.maxZ, g.nz);
+
+    const int cells[3] = {g.nx, g.ny, g.nz};
+    auto cellIndex = [&](int ci, int cj, int ck) {
+        return ((size_t)ck * g.ny + cj) * g.nx + ci;
+    };
+
+    // The cell (or, at the grid's faces, fewer cells) around edge e. Cell q
+    // is offset by -1 along the two other axes as in the quad order a, b, c, d.
+    auto edgeCell = [&](const HermiteEdge& e, int q, size_t& index) {
+        static const int du[4] = {-1, 0, 0, -1};
+        static const int dv[4] = {-1, -1, 0, 0};
+
+        int c[3] = {e.i, e.j, e.k};
+        int u = (e.axis + 1) % 3, v = (e.axis + 2) % 3;
+        c[u] += du[q];
+        c[v] += dv[q];
+
+        for (int a = 0; a < 3; a++)
+            if (c[a] < 0 || c[a] >= cells[a]) return false;
+
+        index = cellIndex(c[0], c[1], c[2]);
+        return true;
+    };
+
+    // Gather each active cell's QEF. Cells are numbered in the order they
+    // are first touched, so the slot table stays 4 bytes per cell.
+    vector<int32_t> cellSlot((size_t)g.nx * g.ny * g.nz, -1);
+    vector<size_t> slotCell;
+    vector<QEF> qefs;
+
+    for (const HermiteEdge& e : edges) {
+        for (int q = 0; q < 4; q++) {
+            size_t index;
+            if (!edgeCell(e, q, index)) continue;
+
+            if (cellSlot[index] < 0) {
+                cellSlot[index] = (int32_t)qefs.size();
+                slotCell.push_back(index);
+                qefs.emplace_back();
+            }
+            qefs[cellSlot[index]].add(e);
+        }
+    }
+
+    // One vertex per active cell, kept inside its cell
+    mesh.vertices.resize(qefs.size() * 3);
+    for (size_t s = 0; s < qefs.size(); s++) {
+        size_t index = slotCell[s];
+        int ci = index % g.nx;
+        int cj = (index / g.nx) % g.ny;
+        int ck = index / ((size_t)g.nx * g.ny);
+
+        double p[3];
+        solve_qef(qefs[s], p);
+
+        mesh.vertices[s * 3 + 0] = clamp((float)p[0], xs[ci], xs[ci + 1]);
+        mesh.vertices[s * 3 + 1] = clamp((float)p[1], ys[cj], ys[cj + 1]);
+        mesh.vertices[s * 3 + 2] = clamp((float)p[2], zs[ck], zs[ck + 1]);
+    }
+
+    // One quad per edge that has all 4 cells. Cells a, b, c, d wind counter
+    // clockwise around the edge's axis, so the quad faces +axis; flip it when
+    // the field decreases along the edge.
+    mesh.indices.reserve(edges.size() * 6);
+    for (const HermiteEdge& e : edges) {
+        uint32_t quad[4];
+        bool complete = true;
+        for (int q = 0; q < 4 && complete; q++) {
+            size_t index;
+            complete = edgeCell(e, q, index);
+            if (complete) quad[q] = (uint32_t)cellSlot[index];
+        }
+        if (!complete) continue;
+
+        if (volume.at(e.i, e.j, e.k) >= isovalue)
+            swap(quad[1], quad[3]);
+
+        mesh.indices.insert(mesh.indices.end(), {quad[0], quad[1], quad[2], quad[0], quad[2], quad[3]});
+    }
+
+    return mesh;
+}
+
+IndexedMesh dual_contouring(function<float(float, float, float)> f, float isovalue, const Grid& grid) {
+    return dual_contouring<const ScalarField&>(f, isovalue, grid);
+}
+
+IndexedMesh dual_contouring(function<float(float, float, float)> f, float isovalue, float min, float max, float stepsize) {
+    return dual_contouring<const ScalarField&>(f, isovalue, make_grid(min, max, stepsize));
+}
@@ -0,0 +1,123 @@
+#ifndef DUAL_CONTOURING_H
+#define DUAL_CONTOURING_H
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+#include "marching_cubes.h"
+#include "sampled_grid.h"
+
+// Dual contouring: one vertex per cell that the surface passes through,
+// placed at the minimizer of a quadratic error function (QEF) built from the
+// crossing points and field normals on the cell's edges, and one quad per
+// crossing edge joining the 4 cells around it. Where the edge normals
+// disagree the vertex lands on the sharp edge or corner they imply, so boxes
+// and CSG shapes keep their sharp features on grids far coarser than
+// marching cubes needs.
+//
+// Takes the same inputs as marching_cubes and returns an IndexedMesh. The
+// front faces point towards values above the isovalue, as with
+// marching_cubes. Unlike marching cubes the result is not guaranteed to be
+// manifold where two sheets pass through one cell.
+
+// Point where the surface crosses a lattice edge and the unit field normal
+// there. The edge starts at lattice point (i, j, k) and runs along axis
+// (0 = x, 1 = y, 2 = z).
+struct HermiteEdge {
+    int i, j, k;
+    int axis;
+    float px, py, pz;
+    float nx, ny, nz;
+};
+
+namespace dc_detail {
+
+// Unit gradient by central differences, or zero where the field is flat
+template <typename F>
+void unit_gradient(F& f, float x, float y, float z, float h, float& gx, float& gy, float& gz) {
+    gx = f(x + h, y, z) - f(x - h, y, z);
+    gy = f(x, y + h, z) - f(x, y - h, z);
+    gz = f(x, y, z + h) - f(x, y, z - h);
+
+    float len = std::sqrt(gx * gx + gy * gy + gz * gz);
+    if (len > 0.0f) {
+        gx /= len;
+        gy /= len;
+        gz /= len;
+    }
+}
+
+}
+
+// Every lattice edge of volume that crosses isovalue, with its normal taken
+// from f (which must be the field volume was sampled from)
+template <typename F>
+std::vector<HermiteEdge> find_hermite_edges(F& f, const SampledGrid& volume, float isovalue) {
+    const Grid& g = volume.grid;
+    std::vector<float> xs = mc_detail::lattice_axis(g.minX, g.maxX, g.nx);
+    std::vector<float> ys = mc_detail::lattice_axis(g.minY, g.maxY, g.ny);
+    std::vector<float> zs = mc_detail::lattice_axis(g.minZ, g.maxZ, g.nz);
+
+    std::vector<HermiteEdge> edges;
+    if (xs.empty() || ys.empty() || zs.empty()) return edges;
+
+    // A hundredth of a cell is small enough to resolve the normal on each
+    // side of a sharp edge, and large enough to stay clear of float noise
+    float h = 0.01f * std::min({(g.maxX - g.minX) / g.nx, (g.maxY - g.minY) / g.ny, (g.maxZ - g.minZ) / g.nz});
+
+    for (int k = 0; k <= g.nz; k++) {
+        for (int j = 0; j <= g.ny; j++) {
+            for (int i = 0; i <= g.nx; i++) {
+                float v0 = volume.at(i, j, k);
+                bool inside = v0 < isovalue;
+
+                for (int axis = 0; axis < 3; axis++) {
+                    int i1 = i + (axis == 0), j1 = j + (axis == 1), k1 = k + (axis == 2);
+                    if (i1 > g.nx || j1 > g.ny || k1 > g.nz) continue;
+
+                    float v1 = volume.at(i1, j1, k1);
+                    if ((v1 < isovalue) == inside) continue;
+
+                    float t = std::clamp((isovalue - v0) / (v1 - v0), 0.0f, 1.0f);
+
+                    HermiteEdge e;
+                    e.i = i;
+                    e.j = j;
+                    e.k = k;
+                    e.axis = axis;
+                    e.px = xs[i] + t * (xs[i1] - xs[i]);
+                    e.py = ys[j] + t * (ys[j1] - ys[j]);
+                    e.pz = zs[k] + t * (zs[k1] - zs[k]);
+                    dc_detail::unit_gradient(f, e.px, e.py, e.pz, h, e.nx, e.ny, e.nz);
+                    edges.push_back(e);
+                }
+            }
+        }
+    }
+
+    return edges;
+}
+
+// Places one vertex per active cell from the QEF of its edges and connects
+// them with a quad (two triangles) per interior crossing edge
+IndexedMesh contour_hermite_edges(const SampledGrid& volume, float isovalue, const std::vector<HermiteEdge>& edges);
+
+IndexedMesh dual_contouring(std::function<float(float, float, float)> f, float isovalue, const Grid& grid);
+IndexedMesh dual_contouring(std::function<float(float, float, float)> f, float isovalue, float min, float max, float stepsize);
+
+template <typename F>
+IndexedMesh dual_contouring(F&& f, float isovalue, const Grid& grid) {
+    SampledGrid volume = sample_grid<F&>(f, grid);
+    if (volume.values.empty()) return IndexedMesh();
+
+    std::vector<HermiteEdge> edges = find_hermite_edges(f, volume, isovalue);
+    return contour_hermite_edges(volume, isovalue, edges);
+}
+
+template <typename F>
+IndexedMesh dual_contouring(F&& f, float isovalue, float min, float max, float stepsize) {
+    return dual_contouring<F&>(f, isovalue, make_grid(min, max, stepsize));
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "gl_mesh.h"
+
+using namespace std;
+
+GLMesh::~GLMesh() {
+    release();
+}
+
+void GLMesh::release() {
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (positionBuffer.id) glDeleteBuffers(1, &positionBuffer.id);
+    if (normalBuffer.id) glDeleteBuffers(1, &normalBuffer.id);
+    if (indexBuffer.id) glDeleteBuffers(1, &indexBuffer.id);
+
+    VAO = 0;
+    positionBuffer = Buffer();
+    normalBuffer = Buffer();
+    indexBuffer = Buffer();
+    numVertices = 0;
+    numIndices = 0;
+}
+
+void GLMesh::createVAO() {
+    if (!VAO) glGenVertexArrays(1, &VAO);
+}
+
+// Grow the buffer only when the data no longer fits, otherwise overwrite it in place
+void GLMesh::upload(Buffer& buffer, GLenum target, const void* data, size_t bytes, GLenum usage) {
+    if (!buffer.id) glGenBuffers(1, &buffer.id);
+
+    glBindBuffer(target, buffer.id);
+    if (bytes > buffer.capacity || bytes == 0) {
+        glBufferData(target, bytes, data, usage);
+        buffer.capacity = bytes;
+    }
+    else {
+        glBufferSubData(target, 0, bytes, data);
+    }
+}
+
+void GLMesh::setPositions(const vector<float>& positions, GLenum usage) {
+    setPositions(positions.data(), positions.size(), usage);
+}
+
+void GLMesh::setPositions(const float* positions, size_t count, GLenum usage) {
+    createVAO();
+    glBindVertexArray(VAO);
+
+    upload(positionBuffer, GL_ARRAY_BUFFER, positions, count * sizeof(float), usage);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    numVertices = count / 3;
+}
+
+void GLMesh::setNormals(const vector<float>& normals, GLenum usage) {
+    createVAO();
+    glBindVertexArray(VAO);
+
+    upload(normalBuffer, GL_ARRAY_BUFFER, normals.data(), normals.size() * sizeof(float), usage);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GLMesh::setIndices(const GLuint* indices, size_t count, GLenum usage) {
+    createVAO();
+
+    // The element buffer binding is part of the VAO, so it stays bound
+    glBindVertexArray(VAO);
+    upload(indexBuffer, GL_ELEMENT_ARRAY_BUFFER, indices, count * sizeof(GLuint), usage);
+    glBindVertexArray(0);
+
+    numIndices = count;
+}
+
+void GLMesh::draw(GLenum mode) const {
+    draw(mode, 0, numIndices ? numIndices : numVertices);
+}
+
+void GLMesh::draw(GLenum mode, GLsizei first, GLsizei count) const {
+    if (!VAO || count <= 0) return;
+
+    glBindVertexArray(VAO);
+    if (numIndices)
+        glDrawElements(mode, count, GL_UNSIGNED_INT, (GLvoid*)(first * sizeof(GLuint)));
+    else
+        glDrawArrays(mode, first, count);
+    glBindVertexArray(0);
+}
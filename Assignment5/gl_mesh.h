@@ -0,0 +1,59 @@
+#ifndef GL_MESH_H
+#define GL_MESH_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// A mesh that lives on the GPU. The VAO and buffers are made once and the
+// data is only sent again when setPositions / setNormals / setIndices is
+// called, so drawing a mesh that did not change costs one bind and one draw
+// call. Re-uploads that fit in the old buffer reuse it with glBufferSubData.
+//
+// Positions go to attribute 0 and normals to attribute 1, as in loadShader.
+// Needs a current GL context for its whole lifetime, so call release() before
+// the context is destroyed.
+class GLMesh {
+public:
+    GLMesh() {}
+    ~GLMesh();
+
+    GLMesh(const GLMesh&) = delete;
+    GLMesh& operator=(const GLMesh&) = delete;
+
+    // x, y, z per vertex
+    void setPositions(const std::vector<float>& positions, GLenum usage = GL_STATIC_DRAW);
+    void setPositions(const float* positions, size_t count, GLenum usage = GL_STATIC_DRAW);
+
+    // nx, ny, nz per vertex
+    void setNormals(const std::vector<float>& normals, GLenum usage = GL_STATIC_DRAW);
+
+    // Once indices are set, draw() uses glDrawElements
+    void setIndices(const GLuint* indices, size_t count, GLenum usage = GL_STATIC_DRAW);
+
+    // Draws everything, or count vertices (indices) starting at first
+    void draw(GLenum mode) const;
+    void draw(GLenum mode, GLsizei first, GLsizei count) const;
+
+    GLsizei vertexCount() const { return numVertices; }
+    GLsizei indexCount() const { return numIndices; }
+
+    // Deletes the GL objects. Safe to call more than once.
+    void release();
+
+private:
+    struct Buffer {
+        GLuint id = 0;
+        size_t capacity = 0;
+    };
+
+    GLuint VAO = 0;
+    Buffer positionBuffer, normalBuffer, indexBuffer;
+    GLsizei numVertices = 0;
+    GLsizei numIndices = 0;
+
+    void createVAO();
+    void upload(Buffer& buffer, GLenum target, const void* data, size_t bytes, GLenum usage);
+};
+
+#endif
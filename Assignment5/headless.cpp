@@ -0,0 +1,134 @@
+#include "headless.h"
+
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+static GLFWwindow* tryContext(int width, int height, int api) {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+    return glfwCreateWindow(width, height, "Marching Cubes", NULL, NULL);
+}
+
+GLFWwindow* createHeadlessContext(int width, int height, string& contextName) {
+    GLFWwindow* window = NULL;
+
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+    // No display needed at all: the null platform with a software context,
+    // or surfaceless EGL. GLFW never picks the null platform by itself, so
+    // without a DISPLAY this is the only way to get EGL at all.
+    if (glfwPlatformSupported(GLFW_PLATFORM_NULL)) {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        if (glfwInit()) {
+            window = tryContext(width, height, GLFW_OSMESA_CONTEXT_API);
+            if (window) {
+                contextName = "osmesa";
+                return window;
+            }
+            window = tryContext(width, height, GLFW_EGL_CONTEXT_API);
+            if (window) {
+                contextName = "egl-surfaceless";
+                return window;
+            }
+            glfwTerminate();
+        }
+        glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+    }
+#endif
+
+    if (!glfwInit()) {
+        cerr << "Could not initialize GLFW for headless rendering\n";
+        return NULL;
+    }
+
+    window = tryContext(width, height, GLFW_EGL_CONTEXT_API);
+    if (window) {
+        contextName = "egl";
+        return window;
+    }
+
+    window = tryContext(width, height, GLFW_NATIVE_CONTEXT_API);
+    if (window) {
+        contextName = "hidden-window";
+        return window;
+    }
+
+    cerr << "Could not create an offscreen GL context (tried OSMesa, EGL and a hidden window)\n";
+    glfwTerminate();
+    return NULL;
+}
+
+Framebuffer::~Framebuffer() {
+    release();
+}
+
+bool Framebuffer::create(int width, int height) {
+    this->width = width;
+    this->height = height;
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "Framebuffer is incomplete: 0x" << hex << status << dec << "\n";
+        return false;
+    }
+    return true;
+}
+
+void Framebuffer::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+}
+
+void Framebuffer::readPixels(vector<unsigned char>& rgb) const {
+    size_t row = (size_t)width * 3;
+    vector<unsigned char> flipped(row * height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, flipped.data());
+
+    // GL returns the bottom row first
+    rgb.resize(flipped.size());
+    for (int y = 0; y < height; y++)
+        copy(flipped.begin() + (height - 1 - y) * row, flipped.begin() + (height - y) * row, rgb.begin() + y * row);
+}
+
+void Framebuffer::release() {
+    if (fbo) glDeleteFramebuffers(1, &fbo);
+    if (colorBuffer) glDeleteRenderbuffers(1, &colorBuffer);
+    if (depthBuffer) glDeleteRenderbuffers(1, &depthBuffer);
+    fbo = colorBuffer = depthBuffer = 0;
+}
+
+bool writePPM(const string& fileName, int width, int height, const vector<unsigned char>& rgb) {
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (!file) {
+        cerr << "Could not open " << fileName << " for writing\n";
+        return false;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
@@ -0,0 +1,44 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <string>
+#include <vector>
+
+// Creates a GL 3.3 context without a display. With GLFW 3.4 this uses the
+// null platform and an OSMesa context (software, e.g. llvmpipe), so it runs
+// on machines with no X server or GPU. Otherwise it falls back to EGL and
+// then to a hidden window. glfwInit is called here, so do not call it first.
+// Returns NULL if no context could be made. contextName is set to the kind
+// of context that worked.
+GLFWwindow* createHeadlessContext(int width, int height, std::string& contextName);
+
+// Color + depth render target. Headless contexts have no default framebuffer
+// worth reading back, so frames are rendered here and read with glReadPixels.
+class Framebuffer {
+public:
+    Framebuffer() {}
+    ~Framebuffer();
+
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    // Returns false if the framebuffer is incomplete
+    bool create(int width, int height);
+    void bind() const;
+
+    // Tightly packed RGB rows, top row first
+    void readPixels(std::vector<unsigned char>& rgb) const;
+
+    void release();
+
+private:
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+    int width = 0, height = 0;
+};
+
+// Binary PPM (P6), readable by most image tools
+bool writePPM(const std::string& fileName, int width, int height, const std::vector<unsigned char>& rgb);
+
+#endif
@@ -0,0 +1,132 @@
+#include "incremental.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+IncrementalExtractor::IncrementalExtractor(function<float(float, float, float)> f, const Grid& grid, float isovalue, int blockSize)
+    : sampled(sample_grid(f, grid)), iso(isovalue) {
+    init(blockSize);
+}
+
+IncrementalExtractor::IncrementalExtractor(SampledGrid volume, float isovalue, int blockSize)
+    : sampled(std::move(volume)), iso(isovalue) {
+    init(blockSize);
+}
+
+void IncrementalExtractor::init(int blockSize) {
+    const Grid& g = sampled.grid;
+    xs = mc_detail::lattice_axis(g.minX, g.maxX, g.nx);
+    ys = mc_detail::lattice_axis(g.minY, g.maxY, g.ny);
+    zs = mc_detail::lattice_axis(g.minZ, g.maxZ, g.nz);
+
+    bricks = build_min_max_bricks(sampled, blockSize);
+    blockTriangles.assign(bricks.minValues.size(), vector<float>());
+
+    vector<size_t> active;
+    for (size_t b = 0; b < blockTriangles.size(); b++)
+        if (bricks.active(b, iso)) active.push_back(b);
+    rebuild(active);
+}
+
+size_t IncrementalExtractor::rebuild(const vector<size_t>& blocks) {
+    const Grid& g = sampled.grid;
+    int B = bricks.brickSize;
+
+    // Blocks write to their own lists, so they can be rebuilt in parallel. A
+    // block is up to B^3 cells, so a single one is already worth a thread.
+    mc_detail::parallel_ranges(blocks.size(), 0, [&](size_t begin, size_t end) {
+        for (size_t n = begin; n < end; n++) {
+            size_t b = blocks[n];
+            int bi = (int)(b % bricks.bx);
+            int bj = (int)(b / bricks.bx % bricks.by);
+            int bk = (int)(b / ((size_t)bricks.bx * bricks.by));
+
+            vector<float>& tris = blockTriangles[b];
+            tris.clear();
+            if (!bricks.active(b, iso)) continue;
+
+            march_sampled_cells(sampled, xs, ys, zs, iso,
+                bi * B, bj * B, bk * B,
+                std::min((bi + 1) * B, g.nx), std::min((bj + 1) * B, g.ny), std::min((bk + 1) * B, g.nz),
+                tris);
+        }
+    }, 1);
+
+    return blocks.size();
+}
+
+size_t IncrementalExtractor::setIsovalue(float isovalue) {
+    if (isovalue == iso) return 0;
+
+    vector<size_t> dirty;
+    for (size_t b = 0; b < blockTriangles.size(); b++)
+        if (bricks.active(b, iso) || bricks.active(b, isovalue)) dirty.push_back(b);
+
+    iso = isovalue;
+    return rebuild(dirty);
+}
+
+// Lattice indices of the points inside [lo, hi] along one axis
+static bool latticeRange(const vector<float>& axis, float lo, float hi, int& first, int& last) {
+    first = (int)(lower_bound(axis.begin(), axis.end(), lo) - axis.begin());
+    last = (int)(upper_bound(axis.begin(), axis.end(), hi) - axis.begin()) - 1;
+    return first <= last;
+}
+
+size_t IncrementalExtractor::updateRegion(function<float(float, float, float)> f,
+    float minX, float minY, float minZ, float maxX, float maxY, float maxZ) {
+
+    const Grid& g = sampled.grid;
+    int i0, i1, j0, j1, k0, k1;
+    if (!latticeRange(xs, minX, maxX, i0, i1) ||
+        !latticeRange(ys, minY, maxY, j0, j1) ||
+        !latticeRange(zs, minZ, maxZ, k0, k1))
+        return 0;
+
+    // Resample the points in the box, a row at a time
+    vector<float> rowX(xs.begin() + i0, xs.begin() + i1 + 1);
+    vector<float> rowY(rowX.size()), rowZ(rowX.size()), row(rowX.size());
+    for (int k = k0; k <= k1; k++) {
+        fill(rowZ.begin(), rowZ.end(), zs[k]);
+        for (int j = j0; j <= j1; j++) {
+            fill(rowY.begin(), rowY.end(), ys[j]);
+            for (size_t i = 0; i < row.size(); i++)
+                row[i] = f(rowX[i], rowY[i], rowZ[i]);
+
+            size_t offset = ((size_t)k * (g.ny + 1) + j) * (g.nx + 1) + i0;
+            copy(row.begin(), row.end(), sampled.values.begin() + offset);
+        }
+    }
+
+    // A point belongs to the cells on both sides of it, so widen by one cell
+    int B = bricks.brickSize;
+    int bi0 = std::max(i0 - 1, 0) / B, bi1 = std::min(i1, g.nx - 1) / B;
+    int bj0 = std::max(j0 - 1, 0) / B, bj1 = std::min(j1, g.ny - 1) / B;
+    int bk0 = std::max(k0 - 1, 0) / B, bk1 = std::min(k1, g.nz - 1) / B;
+
+    vector<size_t> dirty;
+    for (int bk = bk0; bk <= bk1; bk++)
+        for (int bj = bj0; bj <= bj1; bj++)
+            for (int bi = bi0; bi <= bi1; bi++) {
+                refresh_brick(sampled, bricks, bi, bj, bk);
+                dirty.push_back(bricks.index(bi, bj, bk));
+            }
+
+    return rebuild(dirty);
+}
+
+vector<float> IncrementalExtractor::vertices() const {
+    vector<float> all;
+    all.reserve(triangleCount() * 9);
+    for (const auto& tris : blockTriangles)
+        all.insert(all.end(), tris.begin(), tris.end());
+    return all;
+}
+
+size_t IncrementalExtractor::triangleCount() const {
+    size_t count = 0;
+    for (const auto& tris : blockTriangles)
+        count += tris.size() / 9;
+    return count;
+}
@@ -0,0 +1,49 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <functional>
+#include <vector>
+
+#include "sampled_grid.h"
+
+// Keeps a sampled grid, its min/max blocks and the triangles of every block,
+// so small changes only re-polygonize the blocks they can affect.
+//
+// Changing the isovalue rebuilds the blocks whose range straddles the old or
+// the new value; every other block had no triangles and still has none.
+// Editing the field inside a box resamples only the lattice points in the
+// box and rebuilds the blocks whose cells touch them.
+class IncrementalExtractor {
+public:
+    IncrementalExtractor(std::function<float(float, float, float)> f, const Grid& grid, float isovalue, int blockSize = 8);
+    IncrementalExtractor(SampledGrid volume, float isovalue, int blockSize = 8);
+
+    float isovalue() const { return iso; }
+
+    // Returns the number of blocks that were rebuilt
+    size_t setIsovalue(float isovalue);
+
+    // Resample f at every lattice point inside the box and rebuild the blocks
+    // around them. Returns the number of blocks that were rebuilt.
+    size_t updateRegion(std::function<float(float, float, float)> f,
+        float minX, float minY, float minZ, float maxX, float maxY, float maxZ);
+
+    // All triangles, block by block
+    std::vector<float> vertices() const;
+
+    size_t triangleCount() const;
+    size_t blockCount() const { return blockTriangles.size(); }
+    const SampledGrid& volume() const { return sampled; }
+
+private:
+    SampledGrid sampled;
+    MinMaxBricks bricks;
+    std::vector<float> xs, ys, zs;
+    std::vector<std::vector<float>> blockTriangles;
+    float iso;
+
+    void init(int blockSize);
+    size_t rebuild(const std::vector<size_t>& blocks);
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include "lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace std;
+using namespace glm;
+
+float LODLayout::coordinate(int axis, int n) const {
+    if (axis == 0) return domain.minX + n * ((domain.maxX - domain.minX) / domain.nx);
+    if (axis == 1) return domain.minY + n * ((domain.maxY - domain.minY) / domain.ny);
+    return domain.minZ + n * ((domain.maxZ - domain.minZ) / domain.nz);
+}
+
+LODLayout make_lod_layout(const Grid& finest, const vec3& viewPoint, const LODOptions& options) {
+    LODLayout layout;
+    layout.options = options;
+
+    LODOptions& o = layout.options;
+    o.chunkCells = std::max(1, o.chunkCells);
+    o.levels = std::max(1, o.levels);
+    while (o.levels > 1 && o.chunkCells % (1 << (o.levels - 1)) != 0)
+        o.levels--;
+
+    // Round the domain up to whole chunks, keeping the finest cell size
+    int cells[3] = {finest.nx, finest.ny, finest.nz};
+    float mins[3] = {finest.minX, finest.minY, finest.minZ};
+    float maxs[3] = {finest.maxX, finest.maxY, finest.maxZ};
+    int counts[3];
+    for (int a = 0; a < 3; a++) {
+        counts[a] = std::max(1, (cells[a] + o.chunkCells - 1) / o.chunkCells);
+        float step = (maxs[a] - mins[a]) / std::max(1, cells[a]);
+        cells[a] = counts[a] * o.chunkCells;
+        maxs[a] = mins[a] + cells[a] * step;
+    }
+
+    layout.domain = Grid{mins[0], mins[1], mins[2], maxs[0], maxs[1], maxs[2], cells[0], cells[1], cells[2]};
+    layout.cx = counts[0];
+    layout.cy = counts[1];
+    layout.cz = counts[2];
+    layout.levels.resize((size_t)layout.cx * layout.cy * layout.cz);
+
+    // Level from the distance between the view point and the chunk's box
+    for (int ck = 0; ck < layout.cz; ck++) {
+        for (int cj = 0; cj < layout.cy; cj++) {
+            for (int ci = 0; ci < layout.cx; ci++) {
+                int c[3] = {ci, cj, ck};
+                float d2 = 0.0f;
+                for (int a = 0; a < 3; a++) {
+                    float lo = layout.coordinate(a, c[a] * o.chunkCells);
+                    float hi = layout.coordinate(a, (c[a] + 1) * o.chunkCells);
+                    float d = std::max({lo - viewPoint[a], 0.0f, viewPoint[a] - hi});
+                    d2 += d * d;
+                }
+
+                float d = std::sqrt(d2);
+                int level = 0;
+                if (d >= o.lodDistance)
+                    level = std::min(o.levels - 1, 1 + (int)std::floor(std::log2(d / o.lodDistance)));
+
+                layout.levels[layout.index(ci, cj, ck)] = level;
+            }
+        }
+    }
+
+    return layout;
+}
+
+static void chunk_coords(const LODLayout& layout, size_t c, int out[3]) {
+    out[0] = c % layout.cx;
+    out[1] = (c / layout.cx) % layout.cy;
+    out[2] = c / ((size_t)layout.cx * layout.cy);
+}
+
+void lod_chunk_axes(const LODLayout& layout, size_t c, vector<float>& xs, vector<float>& ys, vector<float>& zs) {
+    int cc[3];
+    chunk_coords(layout, c, cc);
+
+    int stride = 1 << layout.levels[c];
+    int n = layout.options.chunkCells / stride;
+
+    vector<float>* axes[3] = {&xs, &ys, &zs};
+    for (int a = 0; a < 3; a++) {
+        axes[a]->resize(n + 1);
+        for (int i = 0; i <= n; i++)
+            (*axes[a])[i] = layout.coordinate(a, cc[a] * layout.options.chunkCells + i * stride);
+    }
+}
+
+vector<size_t> lod_chunk_order(const LODLayout& layout) {
+    vector<size_t> order(layout.levels.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return layout.levels[a] > layout.levels[b];
+    });
+    return order;
+}
+
+// Value of a finished chunk's lattice at finest lattice point g (global
+// indices). g is on the chunk's boundary, so this is at most bilinear, and
+// the weights are exact ratios of integers.
+static float sample_chunk(const LODLayout& layout, const SampledGrid& volume, size_t c, const int g[3]) {
+    int cc[3];
+    chunk_coords(layout, c, cc);
+    int stride = 1 << layout.levels[c];
+    int n = layout.options.chunkCells / stride;
+
+    int i0[3];
+    float t[3];
+    for (int a = 0; a < 3; a++) {
+        int local = g[a] - cc[a] * layout.options.chunkCells;
+        i0[a] = std::min(local / stride, n - 1);
+        t[a] = (float)(local - i0[a] * stride) / stride;
+    }
+
+    float value = 0.0f;
+    for (int corner = 0; corner < 8; corner++) {
+        float w = 1.0f;
+        int p[3];
+        for (int a = 0; a < 3; a++) {
+            int bit = (corner >> a) & 1;
+            w *= bit ? t[a] : 1.0f - t[a];
+            p[a] = i0[a] + bit;
+        }
+        if (w != 0.0f)
+            value += w * volume.at(p[0], p[1], p[2]);
+    }
+    return value;
+}
+
+// Boundary samples shared with a coarser chunk take that chunk's values
+static void take_coarser_samples(const LODLayout& layout, vector<SampledGrid>& volumes, size_t c) {
+    int cc[3];
+    chunk_coords(layout, c, cc);
+    int level = layout.levels[c];
+    int stride = 1 << level;
+    int n = layout.options.chunkCells / stride;
+    int counts[3] = {layout.cx, layout.cy, layout.cz};
+
+    SampledGrid& volume = volumes[c];
+    for (int k = 0; k <= n; k++) {
+        for (int j = 0; j <= n; j++) {
+            for (int i = 0; i <= n; i++) {
+                int local[3] = {i, j, k};
+                bool boundary = false;
+                for (int a = 0; a < 3; a++)
+                    boundary = boundary || local[a] == 0 || local[a] == n;
+                if (!boundary) continue;
+
+                // Every chunk touching this point, as offsets -1, 0, +1 per axis
+                int lo[3], hi[3];
+                for (int a = 0; a < 3; a++) {
+                    lo[a] = local[a] == 0 ? -1 : 0;
+                    hi[a] = local[a] == n ? 1 : 0;
+                }
+
+                size_t coarsest = c;
+                int coarsestLevel = level;
+                for (int dz = lo[2]; dz <= hi[2]; dz++) {
+                    for (int dy = lo[1]; dy <= hi[1]; dy++) {
+                        for (int dx = lo[0]; dx <= hi[0]; dx++) {
+                            int nc[3] = {cc[0] + dx, cc[1] + dy, cc[2] + dz};
+                            if (nc[0] < 0 || nc[1] < 0 || nc[2] < 0 ||
+                                nc[0] >= counts[0] || nc[1] >= counts[1] || nc[2] >= counts[2])
+                                continue;
+
+                            size_t neighbour = layout.index(nc[0], nc[1], nc[2]);
+                            if (layout.levels[neighbour] > coarsestLevel) {
+                                coarsest = neighbour;
+                                coarsestLevel = layout.levels[neighbour];
+                            }
+                        }
+                    }
+                }
+                if (coarsest == c) continue;
+
+                int g[3];
+                for (int a = 0; a < 3; a++)
+                    g[a] = cc[a] * layout.options.chunkCells + local[a] * stride;
+
+                volume.values[((size_t)k * (n + 1) + j) * (n + 1) + i] = sample_chunk(layout, volumes[coarsest], coarsest, g);
+            }
+        }
+    }
+}
+
+// Move the vertices of chunk c that lie inside the face (axis, side) onto
+// the contour that the coarser neighbour across that face has on it
+static void snap_face(const LODLayout& layout, LODChunk& chunk, const LODChunk& neighbour, int axis, int side) {
+    int cc[3] = {chunk.ci, chunk.cj, chunk.ck};
+    int cells = layout.options.chunkCells;
+    float plane = layout.coordinate(axis, (cc[axis] + side) * cells);
+
+    // Crossing points on the plane come out of the interpolation exactly
+    // equal to it, since both ends of their lattice edge lie on it
+    vector<vec3> segments;
+    const vector<float>& nv = neighbour.vertices;
+    for (size_t t = 0; t + 8 < nv.size(); t += 9) {
+        for (int e = 0; e < 3; e++) {
+            const float* a = &nv[t + e * 3];
+            const float* b = &nv[t + ((e + 1) % 3) * 3];
+            if (a[axis] == plane && b[axis] == plane) {
+                segments.push_back(vec3(a[0], a[1], a[2]));
+                segments.push_back(vec3(b[0], b[1], b[2]));
+            }
+        }
+    }
+    if (segments.empty()) return;
+
+    int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    float uLo = layout.coordinate(u, cc[u] * cells), uHi = layout.coordinate(u, (cc[u] + 1) * cells);
+    float vLo = layout.coordinate(v, cc[v] * cells), vHi = layout.coordinate(v, (cc[v] + 1) * cells);
+
+    vector<float>& vertices = chunk.vertices;
+    for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+        float* p = &vertices[i];
+        if (p[axis] != plane) continue;
+
+        // Vertices on the face's rim are shared with more chunks and
+        // already agree with the coarsest of them
+        if (p[u] <= uLo || p[u] >= uHi || p[v] <= vLo || p[v] >= vHi) continue;
+
+        vec3 point(p[0], p[1], p[2]);
+        vec3 best = point;
+        float bestDistance = 1e30f;
+        for (size_t s = 0; s < segments.size(); s += 2) {
+            vec3 a = segments[s], b = segments[s + 1];
+            vec3 ab = b - a;
+            float len2 = dot(ab, ab);
+            float t = len2 > 0.0f ? clamp(dot(point - a, ab) / len2, 0.0f, 1.0f) : 0.0f;
+
+            // Land exactly on the end points, so the shared crossings weld
+            vec3 q = t < 1e-4f ? a : t > 1.0f - 1e-4f ? b : a + ab * t;
+            vec3 d = q - point;
+            float distance = dot(d, d);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = q;
+            }
+        }
+
+        p[0] = best.x;
+        p[1] = best.y;
+        p[2] = best.z;
+        p[axis] = plane;
+    }
+}
+
+void finish_lod_chunk(const LODLayout& layout, vector<LODChunk>& chunks, vector<SampledGrid>& volumes, size_t c, float isovalue) {
+    int cc[3];
+    chunk_coords(layout, c, cc);
+
+    LODChunk& chunk = chunks[c];
+    chunk.ci = cc[0];
+    chunk.cj = cc[1];
+    chunk.ck = cc[2];
+    chunk.level = layout.levels[c];
+    chunk.grid = volumes[c].grid;
+    chunk.vertices.clear();
+
+    take_coarser_samples(layout, volumes, c);
+
+    vector<float> xs, ys, zs;
+    lod_chunk_axes(layout, c, xs, ys, zs);
+    int n = (int)xs.size() - 1;
+    march_sampled_cells(volumes[c], xs, ys, zs, isovalue, 0, 0, 0, n, n, n, chunk.vertices);
+
+    int counts[3] = {layout.cx, layout.cy, layout.cz};
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side = 0; side < 2; side++) {
+            int nc[3] = {cc[0], cc[1], cc[2]};
+            nc[axis] += side ? 1 : -1;
+            if (nc[axis] < 0 || nc[axis] >= counts[axis]) continue;
+
+            size_t neighbour = layout.index(nc[0], nc[1], nc[2]);
+            if (layout.levels[neighbour] > chunk.level)
+                snap_face(layout, chunk, chunks[neighbour], axis, side);
+        }
+    }
+}
+
+vector<LODChunk> marching_cubes_lod(
+    function<float(float, float, float)> f, float isovalue, const Grid& finest,
+    const vec3& viewPoint, const LODOptions& options) {
+    return marching_cubes_lod<const ScalarField&>(f, isovalue, finest, viewPoint, options);
+}
+
+vector<float> merge_lod_chunks(const vector<LODChunk>& chunks) {
+    size_t total = 0;
+    for (const LODChunk& chunk : chunks)
+        total += chunk.vertices.size();
+
+    vector<float> vertices;
+    vertices.reserve(total);
+    for (const LODChunk& chunk : chunks)
+        vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+    return vertices;
+}
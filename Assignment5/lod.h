@@ -0,0 +1,106 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <vector>
+#include <functional>
+
+#include <glm/glm.hpp>
+
+#include "marching_cubes.h"
+#include "sampled_grid.h"
+
+// Chunked level-of-detail marching cubes. The domain is cut into cubes of
+// chunkCells finest cells. A chunk at level L uses cells 2^L times larger,
+// with the level growing with distance from a view point, so far chunks cost
+// a fraction of the triangles.
+//
+// Neighbouring chunks of different levels meet without cracks. Every
+// lattice point on a chunk boundary takes its value from the coarsest chunk
+// touching it, interpolated on that chunk's lattice. The surface then crosses
+// the shared faces along the coarser chunk's edges. A finer chunk's vertices
+// inside a shared face are then snapped onto the coarser chunk's contour on
+// that face. The two sides meet along the same polyline; the finer side has
+// extra collinear vertices on it (T-junctions), but no gaps. Transvoxel
+// style transition cells would avoid the T-junctions, but need its large
+// transition tables.
+struct LODOptions {
+    int chunkCells = 32;          // cells per chunk side at the finest level
+    int levels = 4;               // levels 0 .. levels - 1; chunkCells must divide by 2^(levels - 1)
+    float lodDistance = 2.0f;     // level 1 starts at this distance, and each level after at twice the last
+};
+
+struct LODChunk {
+    int ci = 0, cj = 0, ck = 0;   // chunk coordinates
+    int level = 0;
+    Grid grid;                    // this chunk's lattice
+    std::vector<float> vertices;  // triangle soup, 9 floats per triangle
+};
+
+// How the domain is cut into chunks, and each chunk's level
+struct LODLayout {
+    Grid domain;                  // finest grid, extended to whole chunks
+    LODOptions options;
+    int cx = 0, cy = 0, cz = 0;   // chunk counts
+    std::vector<int> levels;      // per chunk, x fastest
+
+    size_t index(int ci, int cj, int ck) const {
+        return ((size_t)ck * cy + cj) * cx + ci;
+    }
+
+    // Coordinate of finest lattice line n along axis (0 = x, 1 = y, 2 = z).
+    // Every chunk computes its lattice from this, so shared points agree exactly.
+    float coordinate(int axis, int n) const;
+};
+
+LODLayout make_lod_layout(const Grid& finest, const glm::vec3& viewPoint, const LODOptions& options);
+
+// Lattice coordinates of chunk c along each axis
+void lod_chunk_axes(const LODLayout& layout, size_t c, std::vector<float>& xs, std::vector<float>& ys, std::vector<float>& zs);
+
+// Overwrite the boundary samples that belong to coarser neighbours, march
+// the chunk, and snap its face vertices onto coarser neighbours' contours.
+// Every coarser chunk must already be finished.
+void finish_lod_chunk(const LODLayout& layout, std::vector<LODChunk>& chunks, std::vector<SampledGrid>& volumes, size_t c, float isovalue);
+
+// Chunks in order of decreasing level (coarsest first)
+std::vector<size_t> lod_chunk_order(const LODLayout& layout);
+
+std::vector<LODChunk> marching_cubes_lod(
+    std::function<float(float, float, float)> f, float isovalue, const Grid& finest,
+    const glm::vec3& viewPoint, const LODOptions& options = LODOptions());
+
+template <typename F>
+std::vector<LODChunk> marching_cubes_lod(
+    F&& f, float isovalue, const Grid& finest,
+    const glm::vec3& viewPoint, const LODOptions& options = LODOptions()) {
+
+    LODLayout layout = make_lod_layout(finest, viewPoint, options);
+    std::vector<LODChunk> chunks(layout.levels.size());
+    std::vector<SampledGrid> volumes(layout.levels.size());
+
+    std::vector<float> xs, ys, zs, slice;
+    for (size_t c : lod_chunk_order(layout)) {
+        lod_chunk_axes(layout, c, xs, ys, zs);
+
+        SampledGrid& volume = volumes[c];
+        volume.grid = Grid{xs.front(), ys.front(), zs.front(), xs.back(), ys.back(), zs.back(),
+            (int)xs.size() - 1, (int)ys.size() - 1, (int)zs.size() - 1};
+
+        size_t sliceSize = xs.size() * ys.size();
+        volume.values.resize(sliceSize * zs.size());
+        slice.resize(sliceSize);
+        for (size_t k = 0; k < zs.size(); k++) {
+            mc_detail::sample_slice(f, xs, ys, zs[k], slice);
+            std::copy(slice.begin(), slice.end(), volume.values.begin() + k * sliceSize);
+        }
+
+        finish_lod_chunk(layout, chunks, volumes, c, isovalue);
+    }
+
+    return chunks;
+}
+
+// All chunks' triangles in one soup
+std::vector<float> merge_lod_chunks(const std::vector<LODChunk>& chunks);
+
+#endif
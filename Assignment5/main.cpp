@@ -15,6 +15,12 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "marching_cubes.h"
+#include "simplify.h"
+#include "ply_writer.h"
+#include "remesher.h"
+#include "gl_mesh.h"
+#include "shader_program.h"
+#include "headless.h"
 #include "camera.h"
 
 using namespace std;
@@ -33,9 +39,12 @@ GLuint loadShader()
         layout(location = 0) in vec3 pos;
         layout(location = 1) in vec3 normal;
 
-        uniform mat4 MVP;  // Model-view-projection matrix
-        uniform mat4 V;    // View matrix
-        uniform vec3 LightDir;  // Light direction
+        // Per-frame values, one buffer update per frame
+        layout(std140) uniform Frame {
+            mat4 MVP;  // Model-view-projection matrix
+            mat4 V;    // View matrix
+            vec3 LightDir;  // Light direction
+        };
 
         out vec3 fragNormal;
         out vec3 fragLightDir;
@@ -56,11 +65,15 @@ GLuint loadShader()
             in vec3 fragLightDir;
             in vec3 fragViewDir;
         
-            uniform vec3 modelColor;  // Base color for mesh
+            // Surface material, uploaded once
+            layout(std140) uniform Material {
+                vec3 modelColor;  // Base color for mesh
+                float shininess;  // Shininess factor
+                vec3 ambientColor;  // Ambient light color
+                vec3 specularColor;  // Specular light color
+            };
+
             uniform vec3 fragColor;   // Custom Color
-            uniform vec3 ambientColor;  // Ambient light color
-            uniform vec3 specularColor;  // Specular light color
-            uniform float shininess;  // Shininess factor
             uniform bool hasOtherColor;
 
             out vec4 FragColor;
@@ -136,6 +149,27 @@ GLuint loadShader()
     return shaderProgram;
 }
 
+// std140 mirrors of the Frame and Material blocks in loadShader. A vec3
+// takes 16 bytes unless a float follows it.
+const GLuint FRAME_BINDING = 0;
+const GLuint MATERIAL_BINDING = 1;
+
+struct FrameUniforms {
+    mat4 MVP;
+    mat4 V;
+    vec3 lightDir;
+    float pad;
+};
+
+struct MaterialUniforms {
+    vec3 modelColor;
+    float shininess;
+    vec3 ambientColor;
+    float pad0;
+    vec3 specularColor;
+    float pad1;
+};
+
 float lastX = 400, lastY = 300;
 bool firstMouse = true;
 float zoomFactor = 0.5f;
@@ -180,6 +214,25 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     camera.processScroll(yoffset);
 }
 
+// Extraction settings the keys change. The mesh on screen catches up when
+// the background mesher finishes.
+MeshParams meshParams;
+bool meshParamsChanged = false;
+
+// The mesher can't be interrupted, so the keys must not ask for a job that
+// takes minutes. 512 cells per axis is already 134M cells.
+const float MAX_CELLS_PER_AXIS = 512.0f;
+const float MAX_BOUND = 8.0f;
+
+// Keep the bounds within +-MAX_BOUND and the stepsize between the cell
+// limit and 1. Growing the bounds coarsens the cells instead.
+void clampMeshParams(MeshParams& params) {
+    params.min = std::max(-MAX_BOUND, params.min);
+    params.max = std::min(MAX_BOUND, params.max);
+    float minStep = (params.max - params.min) / MAX_CELLS_PER_AXIS;
+    params.stepsize = std::min(1.0f, std::max(minStep, params.stepsize));
+}
+
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods){
 
     if (key == GLFW_KEY_UP && action==GLFW_PRESS){
@@ -189,9 +242,49 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     if (key == GLFW_KEY_DOWN && action==GLFW_PRESS){
         camera.processKeyboard(-zoomFactor);
     }
+
+    if (action != GLFW_PRESS && action != GLFW_REPEAT)
+        return;
+
+    MeshParams old = meshParams;
+
+    // = and - move the isovalue
+    if (key == GLFW_KEY_EQUAL)
+        meshParams.isovalue += 0.05f;
+    if (key == GLFW_KEY_MINUS)
+        meshParams.isovalue -= 0.05f;
+
+    // ] and [ make the cells finer or coarser
+    if (key == GLFW_KEY_RIGHT_BRACKET)
+        meshParams.stepsize *= 0.8f;
+    if (key == GLFW_KEY_LEFT_BRACKET)
+        meshParams.stepsize *= 1.25f;
+
+    // Page up and page down grow or shrink the bounds around the origin
+    if (key == GLFW_KEY_PAGE_UP) {
+        meshParams.min -= 0.25f;
+        meshParams.max += 0.25f;
+    }
+    if (key == GLFW_KEY_PAGE_DOWN && meshParams.max - meshParams.min > 0.75f) {
+        meshParams.min += 0.25f;
+        meshParams.max -= 0.25f;
+    }
+
+    // . and , halve or double the fraction of triangles kept by simplification
+    if (key == GLFW_KEY_PERIOD)
+        meshParams.keepRatio = std::max(1.0f / 64.0f, meshParams.keepRatio * 0.5f);
+    if (key == GLFW_KEY_COMMA)
+        meshParams.keepRatio = std::min(1.0f, meshParams.keepRatio * 2.0f);
+
+    clampMeshParams(meshParams);
+
+    if (meshParams.isovalue != old.isovalue || meshParams.stepsize != old.stepsize ||
+        meshParams.min != old.min || meshParams.max != old.max || meshParams.keepRatio != old.keepRatio)
+        meshParamsChanged = true;
 }
 
-void drawBoundaryBox(float min, float max){
+// The box is rebuilt only when the bounds change, not every frame
+void buildBoundaryBox(GLMesh& box, float min, float max){
     GLfloat vertices[] = {
         // Front Face
         min, min, min, // Front Bottom Left
@@ -212,203 +305,358 @@ void drawBoundaryBox(float min, float max){
         0, 4, 1, 5, 2, 6, 3, 7  // Connecting edges
     };
 
-    GLuint VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // pos attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
-
-    glBindVertexArray(0);
-    
-    glLineWidth(1.0f);
-    // Render the bounding box
-    glBindVertexArray(VAO);
-    glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
+    box.setPositions(vertices, 24);
+    box.setIndices(indices, 24);
 }
 
-void drawArrowHead(vec3 pos, vec3 direction, float size) {
+void addArrowHead(vector<float>& out, vec3 pos, vec3 direction, float size) {
     // Normalize direction
     vec3 arrowDirection = normalize(direction);
 
     // Choose an arbitrary perpendicular reference vector
     vec3 reference = (fabs(arrowDirection.y) > 0.9f) ? vec3(1.0f, 0.0f, 0.0f) : vec3(0.0f, 1.0f, 0.0f);
 
-    // Compute perpendicular vectors
+    // Compute perpendicular vector
     vec3 right = normalize(cross(arrowDirection, reference));
-    vec3 up = normalize(cross(right, arrowDirection));
 
     // Scale the arrowhead
     float arrowHeadLength = size * 0.2f;  // length of the arrowhead
     float arrowHeadWidth = size * 0.1f;   // width of the arrowhead
 
-    // Define arrowhead vertices (triangle fan method)
+    // Define arrowhead vertices
     vec3 tip = pos + arrowDirection * arrowHeadLength;
     vec3 left = pos + right * arrowHeadWidth;
     vec3 rightV = pos - right * arrowHeadWidth;
 
-    GLfloat arrowheadVertices[] = {
+    out.insert(out.end(), {
         tip.x, tip.y, tip.z,
         left.x, left.y, left.z,
         rightV.x, rightV.y, rightV.z
+    });
+}
+
+// All three axes go in one mesh: vertices 2i, 2i+1 are the line of axis i.
+// Their arrowheads go in a second mesh, three vertices per axis.
+void buildAxes(GLMesh& lines, GLMesh& heads, float min, float max) {
+    vec3 origin = vec3(min, min, min);
+    vec3 ends[3] = {
+        vec3((max-min), min, min),
+        vec3(min, (max-min), min),
+        vec3(min, min, (max-min))
     };
 
-    GLuint VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    vector<float> lineVertices, headVertices;
+    for (const vec3& end : ends) {
+        lineVertices.insert(lineVertices.end(), {origin.x, origin.y, origin.z, end.x, end.y, end.z});
+        addArrowHead(headVertices, end, end - origin, 1.0f);
+    }
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(arrowheadVertices), arrowheadVertices, GL_STATIC_DRAW);
+    lines.setPositions(lineVertices);
+    heads.setPositions(headVertices);
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
+void drawAxis(const GLMesh& lines, const GLMesh& heads, int axis) {
+    glLineWidth(2.5f);
+    lines.draw(GL_LINES, 2 * axis, 2);
+    heads.draw(GL_TRIANGLES, 3 * axis, 3);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+void updateTitle(GLFWwindow* window, const MeshParams& shown, bool meshing) {
+    char title[192];
+    snprintf(title, sizeof(title), "Marching Cubes - iso %.2f  step %.4f  bounds [%.2f, %.2f]  keep %.1f%%%s",
+        shown.isovalue, shown.stepsize, shown.min, shown.max, shown.keepRatio * 100.0f, meshing ? "  (meshing...)" : "");
+    glfwSetWindowTitle(window, title);
+}
 
-    // Render the arrowhead (triangle fan)
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
+// Everything the viewer draws, plus the GL state needed to draw it
+struct Scene {
+    ShaderProgram shader;
 
-    // Cleanup
-    glDeleteBuffers(1, &VBO);
-    glDeleteVertexArrays(1, &VAO);
-}
+    // The uniforms that still change between draws
+    GLint fragColorLocation = -1;
+    GLint hasOtherColorLocation = -1;
 
-void drawAxis(vec3 start, vec3 end) {
-    
-    GLfloat lineVertices[] = {
-        start.x, start.y, start.z,
-        end.x, end.y, end.z
-    };
+    UniformBuffer frameBlock, materialBlock;
 
-    GLuint VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    // Everything drawn is uploaded once and kept on the GPU
+    GLMesh surface, box, axisLines, axisHeads;
+    MeshParams guideParams;
+    bool hasGuides = false;
+};
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(lineVertices), lineVertices, GL_STATIC_DRAW);
+void setupScene(Scene& scene) {
+    scene.shader.attach(loadShader());
+    scene.shader.bindBlock("Frame", FRAME_BINDING);
+    scene.shader.bindBlock("Material", MATERIAL_BINDING);
 
-    // Vertex attribute pointer
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
+    scene.fragColorLocation = scene.shader.location("fragColor");
+    scene.hasOtherColorLocation = scene.shader.location("hasOtherColor");
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    scene.frameBlock.create(sizeof(FrameUniforms), FRAME_BINDING);
+    scene.materialBlock.create(sizeof(MaterialUniforms), MATERIAL_BINDING);
 
-    glLineWidth(2.5f);
-    // Render the line
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_LINES, 0, 2);
-    glBindVertexArray(0);
+    MaterialUniforms material = {};
+    material.modelColor = vec3(0.0f, 0.482f, 0.655f);
+    material.shininess = 64.0f;
+    material.ambientColor = vec3(0.2f, 0.2f, 0.2f);
+    material.specularColor = vec3(1.0f, 1.0f, 1.0f);
+    scene.materialBlock.update(material);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glEnable(GL_DEPTH_TEST);
+}
+
+// Upload a new surface. The box and axes are only rebuilt if the bounds moved.
+void setSurface(Scene& scene, const MeshParams& params, const vector<float>& vertices, const vector<float>& normals) {
+    scene.surface.setPositions(vertices);
+    scene.surface.setNormals(normals);
 
-    vec3 direction = end - start;
-    drawArrowHead(end, direction, 1.0f);
+    if (!scene.hasGuides || params.min != scene.guideParams.min || params.max != scene.guideParams.max) {
+        scene.guideParams = params;
+        scene.hasGuides = true;
+        buildBoundaryBox(scene.box, params.min, params.max);
+        buildAxes(scene.axisLines, scene.axisHeads, params.min, params.max);
+    }
 }
 
-void drawMarchingCubes(const vector<float>& vertices, const vector<float>& normals) {
+void drawScene(Scene& scene, int width, int height) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    
+    glm::mat4 model = glm::mat4(1.0f);
+    mat4 view = camera.getViewMatrix();
+    mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+    mat4 MVP = projection * view * model;
+
+    scene.shader.use();
+
+    FrameUniforms frame = {};
+    frame.MVP = MVP;
+    frame.V = view;
+    frame.lightDir = vec3(0.0f, 0.0f, -1.0f);
+    scene.frameBlock.update(frame);
+
+    // Draw the bounding box and axes
+    glUniform1i(scene.hasOtherColorLocation, 1);
+    glUniform3f(scene.fragColorLocation, 1.0f, 1.0f, 1.0f);
+    glLineWidth(1.0f);
+    scene.box.draw(GL_LINES);
+
+    glUniform3f(scene.fragColorLocation, 1.0f, 0.0f, 0.0f);
+    drawAxis(scene.axisLines, scene.axisHeads, 0);
+
+    glUniform3f(scene.fragColorLocation, 0.0f, 1.0f, 0.0f);
+    drawAxis(scene.axisLines, scene.axisHeads, 1);
     
-    GLuint VBO, VAO, NBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &NBO);
+    glUniform3f(scene.fragColorLocation, 0.0f, 0.0f, 1.0f);
+    drawAxis(scene.axisLines, scene.axisHeads, 2);
 
-    glBindVertexArray(VAO);
 
-    // Store vertices
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+    glUniform1i(scene.hasOtherColorLocation, 0);
+    scene.surface.draw(GL_TRIANGLES);
+}
 
-    // Store normals
-    glBindBuffer(GL_ARRAY_BUFFER, NBO);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), &normals[0], GL_STATIC_DRAW);
+// The buffers must go before the context does
+void releaseScene(Scene& scene) {
+    scene.surface.release();
+    scene.box.release();
+    scene.axisLines.release();
+    scene.axisHeads.release();
+    scene.frameBlock.release();
+    scene.materialBlock.release();
+    glDeleteProgram(scene.shader.id());
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
+// The surface being meshed. Plain sin/cos, so the mesh is the same on every CPU.
+static float sineCosine(float x, float y, float z) {
+    return y - sin(x) * cos(z);
+}
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(1);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+// Triangle soup of the surface. With keepRatio below 1 the welded mesh is
+// simplified first, which only pays off on fine grids.
+vector<float> extractSurface(const MeshParams& params, unsigned numThreads) {
+    if (params.keepRatio >= 1.0f)
+        return marching_cubes_parallel(sineCosine, params.isovalue, params.min, params.max, params.stepsize, numThreads);
 
-    glBindVertexArray(0);
+    IndexedMesh mesh = marching_cubes_indexed(sineCosine, params.isovalue, params.min, params.max, params.stepsize);
+    return unweld(simplify_mesh(mesh, params.keepRatio));
+}
 
-    // Draw the cubes
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 3);
-    glBindVertexArray(0);
+// Smooth normals from the field gradient, offset by half a cell
+vector<float> surfaceNormals(const vector<float>& vertices, const MeshParams& params, unsigned numThreads) {
+    return compute_normals_gradient(sineCosine, vertices, params.stepsize * 0.5f, numThreads);
+}
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &NBO);
+static double millisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
 
+// Text as the body of a JSON string: quotes, backslashes (Windows paths) and
+// control characters are escaped
+static string jsonEscape(const string& text) {
+    string out;
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        }
+        else if (c == '\n') out += "\\n";
+        else if (c == '\r') out += "\\r";
+        else if (c == '\t') out += "\\t";
+        else if (c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            out += code;
+        }
+        else out += (char)c;
+    }
+    return out;
 }
 
-void writePLY(const vector<float>& vertices, const vector<float>& normals, const string& fileName) {
-    ofstream outFile(fileName);
+// Extract once, render frames into an offscreen framebuffer, save the last
+// one and print the timings as JSON on stdout
+int runHeadless(int width, int height, int frames, const string& imagePath) {
+    string contextName;
+    GLFWwindow* window = createHeadlessContext(width, height, contextName);
+    if (!window)
+        return -1;
 
-    if (!outFile) {
-        cerr << "Error opening file: " << fileName << endl;
-        return;
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // A GLX build of GLEW says this on an EGL or OSMesa context, after it
+    // has already loaded the GL functions
+    if (glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)
+        glewStatus = GLEW_OK;
+#endif
+    if (glewStatus != GLEW_OK) {
+        cerr << "Failed to initialize GLEW: " << glewGetErrorString(glewStatus) << "\n";
+        glfwTerminate();
+        return -1;
     }
 
-    // Write PLY header
-    outFile << "ply\n\n";
-    outFile << "format ascii 1.0\n";
-    outFile << "element vertex " << vertices.size() / 3 << "\n";
-    outFile << "property float x\n";
-    outFile << "property float y\n";
-    outFile << "property float z\n";
-    outFile << "property float nx\n";
-    outFile << "property float ny\n";
-    outFile << "property float nz\n";
-    outFile << "element face " << vertices.size() / 3 / 3 << "\n";
-    outFile << "property list uchar int vertex_index\n";
-    outFile << "end_header\n\n";
-
-    // Write vertices and normals
-    for (size_t i = 0; i < vertices.size() / 3; ++i) {
-        outFile << vertices[i * 3] << " " << vertices[i * 3 + 1] << " " << vertices[i * 3 + 2] << " ";
-        outFile << normals[i * 3] << " " << normals[i * 3 + 1] << " " << normals[i * 3 + 2] << "\n";
+    Scene scene;
+    setupScene(scene);
+
+    // The framebuffer's destructor deletes GL objects, so it is released
+    // by hand before the context goes away
+    Framebuffer target;
+    if (!target.create(width, height)) {
+        target.release();
+        releaseScene(scene);
+        glfwTerminate();
+        return -1;
     }
 
-    // Write faces (triangles)
-    for (size_t i = 0; i < vertices.size() / 3 / 3; ++i) {
-        outFile << "3 " << i * 3 << " " << i * 3 + 1 << " " << i * 3 + 2 << "\n";
+    MeshParams params = meshParams;
+
+    auto start = chrono::steady_clock::now();
+    vector<float> vertices = extractSurface(params, 0);
+    double extractMs = millisecondsSince(start);
+
+    start = chrono::steady_clock::now();
+    vector<float> normals = surfaceNormals(vertices, params, 0);
+    double normalsMs = millisecondsSince(start);
+
+    // glFinish so the time covers the copy, not just queuing it
+    start = chrono::steady_clock::now();
+    setSurface(scene, params, vertices, normals);
+    glFinish();
+    double uploadMs = millisecondsSince(start);
+
+    target.bind();
+
+    // The first frame pays for shader compilation in most drivers, so it is
+    // reported on its own and left out of the average
+    start = chrono::steady_clock::now();
+    drawScene(scene, width, height);
+    glFinish();
+    double firstFrameMs = millisecondsSince(start);
+
+    double totalMs = 0.0, minMs = 1e30, maxMs = 0.0;
+    for (int i = 0; i < frames; i++) {
+        start = chrono::steady_clock::now();
+        drawScene(scene, width, height);
+        glFinish();
+        double frameMs = millisecondsSince(start);
+
+        totalMs += frameMs;
+        minMs = std::min(minMs, frameMs);
+        maxMs = std::max(maxMs, frameMs);
     }
 
-    outFile.close();
+    vector<unsigned char> pixels;
+    target.readPixels(pixels);
+    bool saved = writePPM(imagePath, width, height, pixels);
+
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+
+    printf("{\n");
+    printf("  \"context\": \"%s\",\n", jsonEscape(contextName).c_str());
+    printf("  \"renderer\": \"%s\",\n", jsonEscape(renderer ? renderer : "unknown").c_str());
+    printf("  \"width\": %d,\n", width);
+    printf("  \"height\": %d,\n", height);
+    printf("  \"stepsize\": %g,\n", params.stepsize);
+    printf("  \"keep_ratio\": %g,\n", params.keepRatio);
+    printf("  \"triangles\": %zu,\n", vertices.size() / 9);
+    printf("  \"extract_ms\": %.3f,\n", extractMs);
+    printf("  \"normals_ms\": %.3f,\n", normalsMs);
+    printf("  \"upload_ms\": %.3f,\n", uploadMs);
+    printf("  \"first_frame_ms\": %.3f,\n", firstFrameMs);
+    printf("  \"frames\": %d,\n", frames);
+    printf("  \"frame_ms_avg\": %.3f,\n", frames > 0 ? totalMs / frames : 0.0);
+    printf("  \"frame_ms_min\": %.3f,\n", frames > 0 ? minMs : 0.0);
+    printf("  \"frame_ms_max\": %.3f,\n", maxMs);
+    printf("  \"image\": \"%s\"\n", saved ? jsonEscape(imagePath).c_str() : "");
+    printf("}\n");
+
+    target.release();
+    releaseScene(scene);
+    glfwTerminate();
+    return saved ? 0 : -1;
 }
 
 int main(int argc, char **argv)
 {
 
-    if (argc != 3)
+    if (argc < 3)
     {
         cerr << "Please Enter the Screen Width and Screen Height\n";
+        cerr << "Usage: " << argv[0] << " WIDTH HEIGHT [--headless FRAMES [IMAGE.ppm] [STEPSIZE] [KEEP]]\n";
         return -1;
     }
 
     int width = atoi(argv[1]);
     int height = atoi(argv[2]);
 
+    if (argc > 3)
+    {
+        if (string(argv[3]) != "--headless")
+        {
+            cerr << "Unknown option " << argv[3] << "\n";
+            return -1;
+        }
+
+        int frames = argc > 4 ? atoi(argv[4]) : 100;
+        string imagePath = argc > 5 ? argv[5] : "frame.ppm";
+        if (argc > 6)
+        {
+            char* end = nullptr;
+            float stepsize = strtof(argv[6], &end);
+            if (end == argv[6] || *end != '\0' || !(stepsize > 0.0f) || !isfinite(stepsize))
+            {
+                cerr << "STEPSIZE must be a number above 0, not " << argv[6] << "\n";
+                return -1;
+            }
+            meshParams.stepsize = stepsize;
+        }
+        if (argc > 7)
+            meshParams.keepRatio = std::min(1.0f, std::max(0.0f, (float)atof(argv[7])));
+
+        return runHeadless(width, height, frames, imagePath);
+    }
+
     if (!glfwInit())
         return -1;
 
@@ -418,87 +666,60 @@ int main(int argc, char **argv)
 
     glewInit();
 
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
 
-    GLuint shaderID = loadShader();
-
-    float isovalue = 0.0f, min = -1.5f, max =  1.5f, stepsize = 0.1f;
+    Scene scene;
+    setupScene(scene);
 
-    auto vertices = marching_cubes([](float x, float y, float z) {
-        return y - sin(x)*cos(z);
-    }, isovalue, min, max, stepsize);
+    // Leave a core for the render loop while meshing in the background.
+    // hardware_concurrency() is 0 when it can't tell, so don't subtract from that.
+    unsigned hc = thread::hardware_concurrency();
+    unsigned meshThreads = hc > 1 ? hc - 1 : 1;
 
-    vector<float> normals = compute_normals(vertices);
+    BackgroundMesher mesher([&](const MeshParams& params, vector<float>& vertices, vector<float>& normals) {
+        vertices = extractSurface(params, meshThreads);
+        normals = surfaceNormals(vertices, params, meshThreads);
+    });
 
-    writePLY(vertices, normals, "./fileName.ply");
+    // The first mesh is built before the window shows and saved to disk
+    MeshParams shownParams = meshParams;
+    vector<float> vertices, normals;
+    mesher.request(meshParams);
+    while (!mesher.poll(shownParams, vertices, normals))
+        this_thread::sleep_for(chrono::milliseconds(1));
 
-    unsigned int VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    writePLYBinary(vertices, normals, "./fileName.ply");
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-
-    glEnable(GL_DEPTH_TEST);
+    setSurface(scene, shownParams, vertices, normals);
+    updateTitle(window, shownParams, false);
 
     while (!glfwWindowShouldClose(window))
     {
         glfwPollEvents();
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glm::mat4 model = glm::mat4(1.0f);
-        mat4 view = camera.getViewMatrix();
-        mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
-        mat4 MVP = projection * view * model;
-
-        glUseProgram(shaderID);
-
-        glUniformMatrix4fv(glGetUniformLocation(shaderID, "MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
-        glUniformMatrix4fv(glGetUniformLocation(shaderID, "V"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniform3f(glGetUniformLocation(shaderID, "LightDir"), 0.0f, 0.0f, -1.0f);
-        glUniform3f(glGetUniformLocation(shaderID, "modelColor"), 0.0f, 0.482f, 0.655f);
-        glUniform1f(glGetUniformLocation(shaderID, "shininess"), 64.0f);
-        glUniform3f(glGetUniformLocation(shaderID, "ambientColor"), 0.2f, 0.2f, 0.2f);
-        glUniform3f(glGetUniformLocation(shaderID, "specularColor"), 1.0f, 1.0f, 1.0f);
-
-        // Draw the bounding box and axes
-        glUniform1i(glGetUniformLocation(shaderID, "hasOtherColor"), 1);
-        glUniform3f(glGetUniformLocation(shaderID, "fragColor"), 1.0f, 1.0f, 1.0f);
-        drawBoundaryBox(min, max);
-        
-        vec3 origin = vec3(min, min, min);
-        vec3 xAxis = vec3((max-min), min, min);
-        vec3 yAxis = vec3(min, (max-min), min);
-        vec3 zAxis = vec3(min, min, (max-min));
-
-        glUniform3f(glGetUniformLocation(shaderID, "fragColor"), 1.0f, 0.0f, 0.0f);
-        drawAxis(origin, xAxis);
-
-        glUniform3f(glGetUniformLocation(shaderID, "fragColor"), 0.0f, 1.0f, 0.0f);
-        drawAxis(origin, yAxis);
-        
-        glUniform3f(glGetUniformLocation(shaderID, "fragColor"), 0.0f, 0.0f, 1.0f);
-        drawAxis(origin, zAxis);
+        if (meshParamsChanged) {
+            meshParamsChanged = false;
+            mesher.request(meshParams);
+            updateTitle(window, shownParams, true);
+        }
 
+        // Swap in a finished mesh; the render loop never waits for one
+        if (mesher.poll(shownParams, vertices, normals)) {
+            setSurface(scene, shownParams, vertices, normals);
+            updateTitle(window, shownParams, mesher.busy());
+        }
 
-        glUniform1i(glGetUniformLocation(shaderID, "hasOtherColor"), 0);
-        drawMarchingCubes(vertices, normals);
+        drawScene(scene, width, height);
 
         glfwSwapBuffers(window);
     }
 
-    
+    releaseScene(scene);
+
     glfwTerminate();
     return 0;
 }
 
-// g++ main.cpp camera.cpp marching_cubes.cpp -o main.exe -lfreeglut -lglew32 -lopengl32 -lglfw3 -lm -lstdc++
\ No newline at end of file
+// g++ main.cpp camera.cpp marching_cubes.cpp ply_writer.cpp remesher.cpp gl_mesh.cpp shader_program.cpp headless.cpp simplify.cpp -o main.exe -lfreeglut -lglew32 -lopengl32 -lglfw3 -lm -lstdc++ -pthread
\ No newline at end of file
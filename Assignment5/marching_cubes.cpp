@@ -1,159 +1,113 @@
 #include "marching_cubes.h"
-#include "TriTable.hpp"
 #include <glm/glm.hpp>
 #include <iostream>
 #include <vector>
+#include <cmath>
 
 using namespace std;
 using namespace glm;
 
-struct Vec3 {
-    float x, y, z;
+// Flat normals for triangles [begin, end) of a soup. Written without branches
+// on plain float arrays so the compiler can vectorize the loop.
+static void flat_normals(const float* v, float* n, size_t begin, size_t end) {
+    for (size_t t = begin; t < end; t++) {
+        const float* p = v + t * 9;
 
-    Vec3() : x(0), y(0), z(0) {}
-    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+        // Two edges of the triangle
+        float e1x = p[3] - p[0], e1y = p[4] - p[1], e1z = p[5] - p[2];
+        float e2x = p[6] - p[0], e2y = p[7] - p[1], e2z = p[8] - p[2];
 
-    // Vector subtraction
-    Vec3 operator-(const Vec3& other) const {
-        return Vec3(x - other.x, y - other.y, z - other.z);
-    }
+        // Cross product to get the normal
+        float nx = e1y * e2z - e1z * e2y;
+        float ny = e1z * e2x - e1x * e2z;
+        float nz = e1x * e2y - e1y * e2x;
 
-    // Cross product
-    Vec3 cross(const Vec3& other) const {
-        return Vec3(
-            y * other.z - z * other.y,
-            z * other.x - x * other.z,
-            x * other.y - y * other.x
-        );
-    }
+        // Normalize, leaving degenerate triangles as zero
+        float len = sqrt(nx * nx + ny * ny + nz * nz);
+        float inv = len > 0.0f ? 1.0f / len : 0.0f;
+        nx *= inv;
+        ny *= inv;
+        nz *= inv;
 
-    // Normalize the vector
-    void normalize() {
-        float length = sqrt(x * x + y * y + z * z);
-        if (length > 0) {
-            x /= length;
-            y /= length;
-            z /= length;
+        // Store the same normal for all three vertices of the triangle
+        float* out = n + t * 9;
+        for (int j = 0; j < 3; ++j) {
+            out[j * 3] = nx;
+            out[j * 3 + 1] = ny;
+            out[j * 3 + 2] = nz;
         }
     }
-};
+}
 
-vector<float> compute_normals(const vector<float>& vertices) {
-    vector<float> normals;
-    int numVertices = vertices.size() / 3;
-    normals.resize(vertices.size());
+vector<float> compute_normals(const vector<float>& vertices, unsigned numThreads) {
+    vector<float> normals(vertices.size());
+    size_t numTriangles = vertices.size() / 9;
 
-    for (int i = 0; i < numVertices; i += 3) {
-        // Get three vertices of the triangle
-        Vec3 v0(vertices[i], vertices[i + 1], vertices[i + 2]);
-        Vec3 v1(vertices[i + 3], vertices[i + 4], vertices[i + 5]);
-        Vec3 v2(vertices[i + 6], vertices[i + 7], vertices[i + 8]);
+    mc_detail::parallel_ranges(numTriangles, numThreads, [&](size_t begin, size_t end) {
+        flat_normals(vertices.data(), normals.data(), begin, end);
+    });
 
-        // Compute two edges
-        Vec3 edge1 = v1 - v0;
-        Vec3 edge2 = v2 - v0;
+    return normals;
+}
 
-        // Cross product to get the normal
-        Vec3 normal = edge1.cross(edge2);
-        normal.normalize();  // Normalize the normal
+vector<float> compute_normals_gradient(
+    function<float(float, float, float)> f,
+    const vector<float>& vertices, float h, unsigned numThreads) {
+    return compute_normals_gradient<const ScalarField&>(f, vertices, h, numThreads);
+}
 
-        // Store the same normal for all three vertices of the triangle
-        for (int j = 0; j < 3; ++j) {
-            normals[i + j * 3] = normal.x;
-            normals[i + j * 3 + 1] = normal.y;
-            normals[i + j * 3 + 2] = normal.z;
-        }
-    }
-    
-    return normals;
+Grid make_grid(float min, float max, float stepsize) {
+    // Allow for the division landing just above a whole number
+    int n = std::max(0, (int)ceil((max - min) / stepsize - 1e-4f));
+    float end = min + n * stepsize;
+    return Grid{min, min, min, end, end, end, n, n, n};
 }
 
+// The std::function entry points forward to the templates in
+// marching_cubes_impl.hpp, which see f only through its call operator
+
+vector<float> marching_cubes(
+    function<float(float, float, float)> f,
+    float isovalue, float min, float max, float stepsize) {
+    return marching_cubes<const ScalarField&>(f, isovalue, min, max, stepsize);
+}
 
-// Function to interpolate a vertex along an edge using the vertTable
-vec3 interpolateVertex(int edgeIndex, const vec3& p0, const vec3& p1, float val0, float val1, float isovalue) {
-    // Compute the interpolation factor along the edge
-    float t = (isovalue - val0) / (val1 - val0);
-    t = std::clamp(t, 0.0f, 1.0f);
+vector<float> marching_cubes_cached(
+    function<float(float, float, float)> f,
+    float isovalue, float min, float max, float stepsize) {
+    return marching_cubes_cached<const ScalarField&>(f, isovalue, min, max, stepsize);
+}
 
-    // Compute the interpolated position using the edge direction from vertTable
-    vec3 edgeDirection(vertTable[edgeIndex][0], vertTable[edgeIndex][1], vertTable[edgeIndex][2]);
-    return vec3(
-        p0.x + t * (p1.x - p0.x),
-        p0.y + t * (p1.y - p0.y),
-        p0.z + t * (p1.z - p0.z)
-    );
+vector<float> marching_cubes_parallel(
+    function<float(float, float, float)> f,
+    float isovalue, float min, float max, float stepsize, unsigned numThreads) {
+    return marching_cubes_parallel<const ScalarField&>(f, isovalue, min, max, stepsize, numThreads);
 }
 
-vector<float> marching_cubes(
+IndexedMesh marching_cubes_indexed(
     function<float(float, float, float)> f,
     float isovalue, float min, float max, float stepsize) {
+    return marching_cubes_indexed<const ScalarField&>(f, isovalue, min, max, stepsize);
+}
 
-    vector<float> vertices;
-
-    for (float z = min; z < max; z += stepsize) {
-        for (float y = min; y < max; y += stepsize) {
-            for (float x = min; x < max; x += stepsize) {
-
-                float cubeValues[8];
-                vec3 corners[8] = {
-                    {x, y, z}, {x + stepsize, y, z}, {x + stepsize, y + stepsize, z}, {x, y + stepsize, z},
-                    {x, y, z + stepsize}, {x + stepsize, y, z + stepsize}, {x + stepsize, y + stepsize, z + stepsize}, {x, y + stepsize, z + stepsize}
-                };
-
-                // Get scalar values at the 8 cube corners
-                for (int i = 0; i < 8; i++) {
-                    cubeValues[i] = f(corners[i].x, corners[i].y, corners[i].z);
-                }
-
-                int cubeIndex = 0;
-                for (int i = 0; i < 8; ++i)
-                    if (cubeValues[i] < isovalue) cubeIndex |= (1 << i);
-
-                // If the cube is entirely inside or outside the isosurface, skip it
-                if (cubeIndex == 0 || cubeIndex == 255) continue;
-
-                // Get the edge table for the current cube configuration
-                const int* edges = marching_cubes_lut[cubeIndex];
-
-                // Iterate over the edges to form triangles
-                for (int i = 0; edges[i] != -1; i += 3) {  // Each triangle has 3 edges
-                    // Get the 3 edges that form the triangle
-                    int edge1 = edges[i];
-                    int edge2 = edges[i + 1];
-                    int edge3 = edges[i + 2];
-
-                    // Interpolate the vertices along the edges where the isosurface crosses
-                    vec3 p1, p2, p3;
-
-                    // Interpolate along edge1
-                    int v0 = edge1 / 2;
-                    int v1 = (edge1 + 1) / 2;
-                    p1 = interpolateVertex(edge1, corners[v0], corners[v1], cubeValues[v0], cubeValues[v1], isovalue);
-
-                    // Interpolate along edge2
-                    v0 = edge2 / 2;
-                    v1 = (edge2 + 1) / 2;
-                    p2 = interpolateVertex(edge2, corners[v0], corners[v1], cubeValues[v0], cubeValues[v1], isovalue);
-
-                    // Interpolate along edge3
-                    v0 = edge3 / 2;
-                    v1 = (edge3 + 1) / 2;
-                    p3 = interpolateVertex(edge3, corners[v0], corners[v1], cubeValues[v0], cubeValues[v1], isovalue);
-
-                    // Store the triangle vertices
-                    vertices.push_back(p1.x);
-                    vertices.push_back(p1.y);
-                    vertices.push_back(p1.z);
-                    vertices.push_back(p2.x);
-                    vertices.push_back(p2.y);
-                    vertices.push_back(p2.z);
-                    vertices.push_back(p3.x);
-                    vertices.push_back(p3.y);
-                    vertices.push_back(p3.z);
-                }
-            }
-        }
-    }
+vector<float> marching_cubes(function<float(float, float, float)> f, float isovalue, const Grid& grid) {
+    return marching_cubes<const ScalarField&>(f, isovalue, grid);
+}
+
+vector<float> marching_cubes_cached(function<float(float, float, float)> f, float isovalue, const Grid& grid) {
+    return marching_cubes_cached<const ScalarField&>(f, isovalue, grid);
+}
+
+vector<float> marching_cubes_parallel(function<float(float, float, float)> f, float isovalue, const Grid& grid, unsigned numThreads) {
+    return marching_cubes_parallel<const ScalarField&>(f, isovalue, grid, numThreads);
+}
+
+IndexedMesh marching_cubes_indexed(function<float(float, float, float)> f, float isovalue, const Grid& grid) {
+    return marching_cubes_indexed<const ScalarField&>(f, isovalue, grid);
+}
 
-    return vertices;
+size_t marching_cubes_stream(
+    function<float(float, float, float)> f, float isovalue, const Grid& grid,
+    const TriangleSink& sink, int slabCells) {
+    return marching_cubes_stream<const ScalarField&>(f, isovalue, grid, sink, slabCells);
 }
@@ -3,11 +3,131 @@
 
 #include <vector>
 #include <functional>
+#include <cstdint>
+
+typedef std::function<float(float, float, float)> ScalarField;
+
+// Welded triangle mesh: x, y, z per vertex and 3 vertex indices per triangle
+struct IndexedMesh {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// Axis-aligned lattice of nx * ny * nz cells from (minX, minY, minZ) to
+// (maxX, maxY, maxZ). Lattice point (i, j, k) sits at minX + i * (maxX - minX) / nx
+// and so on, computed from the index so there is no accumulated rounding.
+struct Grid {
+    float minX, minY, minZ;
+    float maxX, maxY, maxZ;
+    int nx, ny, nz;
+};
+
+// Cube from min to max with cells of size stepsize. The cell count is rounded
+// up, so the far side is extended to a whole number of cells past max.
+Grid make_grid(float min, float max, float stepsize);
+
+// Every extractor takes either a Grid or the cube-shaped (min, max, stepsize)
+// form, which is the same as passing make_grid(min, max, stepsize).
+//
+// Every extractor also comes in two forms. The std::function one is compiled once
+// in marching_cubes.cpp. The template one takes any callable
+// float(float, float, float) and is instantiated per field type, so a lambda
+// gets inlined into the sampling loop instead of called through a pointer.
+// Both produce the same output.
 
 std::vector<float> marching_cubes(
     std::function<float(float, float, float)> f,
     float isovalue, float min, float max, float stepsize);
 
-std::vector<float> compute_normals(const std::vector<float>& vertices);
+template <typename F>
+std::vector<float> marching_cubes(F&& f, float isovalue, float min, float max, float stepsize);
+
+std::vector<float> marching_cubes(
+    std::function<float(float, float, float)> f, float isovalue, const Grid& grid);
+
+template <typename F>
+std::vector<float> marching_cubes(F&& f, float isovalue, const Grid& grid);
+
+// Same output as marching_cubes, but f is sampled once per lattice point into a
+// rolling two-slice buffer instead of 8 times per cell.
+std::vector<float> marching_cubes_cached(
+    std::function<float(float, float, float)> f,
+    float isovalue, float min, float max, float stepsize);
+
+template <typename F>
+std::vector<float> marching_cubes_cached(F&& f, float isovalue, float min, float max, float stepsize);
+
+std::vector<float> marching_cubes_cached(
+    std::function<float(float, float, float)> f, float isovalue, const Grid& grid);
+
+template <typename F>
+std::vector<float> marching_cubes_cached(F&& f, float isovalue, const Grid& grid);
+
+// Same output as marching_cubes, but the z cells are split into slabs that are
+// marched on numThreads worker threads (0 = hardware concurrency). Each slab
+// samples f through its own rolling slice buffer.
+// f is called concurrently, so it must be safe to call from several threads.
+std::vector<float> marching_cubes_parallel(
+    std::function<float(float, float, float)> f,
+    float isovalue, float min, float max, float stepsize, unsigned numThreads = 0);
+
+template <typename F>
+std::vector<float> marching_cubes_parallel(F&& f, float isovalue, float min, float max, float stepsize, unsigned numThreads = 0);
+
+std::vector<float> marching_cubes_parallel(
+    std::function<float(float, float, float)> f, float isovalue, const Grid& grid, unsigned numThreads = 0);
+
+template <typename F>
+std::vector<float> marching_cubes_parallel(F&& f, float isovalue, const Grid& grid, unsigned numThreads = 0);
+
+// Same surface as marching_cubes, but vertices on cell edges shared between
+// neighbouring cells are emitted once and referenced by index.
+IndexedMesh marching_cubes_indexed(
+    std::function<float(float, float, float)> f,
+    float isovalue, float min, float max, float stepsize);
+
+template <typename F>
+IndexedMesh marching_cubes_indexed(F&& f, float isovalue, float min, float max, float stepsize);
+
+IndexedMesh marching_cubes_indexed(
+    std::function<float(float, float, float)> f, float isovalue, const Grid& grid);
+
+template <typename F>
+IndexedMesh marching_cubes_indexed(F&& f, float isovalue, const Grid& grid);
+
+// Receives one batch of triangles (9 floats each) at a time. The batch is
+// only valid during the call. Returning false (a write failed) stops the
+// extraction.
+typedef std::function<bool(const std::vector<float>& triangles)> TriangleSink;
+
+// Streaming marching_cubes: the grid is marched slabCells layers of cells at a
+// time, and each slab's triangles are passed to sink and then dropped. Memory
+// stays at two lattice slices plus one slab of triangles however large the
+// grid is. The batches arrive in marching_cubes order. Returns the number of
+// triangles, counting only the batches the sink accepted if it stopped early.
+size_t marching_cubes_stream(
+    std::function<float(float, float, float)> f, float isovalue, const Grid& grid,
+    const TriangleSink& sink, int slabCells = 16);
+
+template <typename F>
+size_t marching_cubes_stream(F&& f, float isovalue, const Grid& grid, const TriangleSink& sink, int slabCells = 16);
+
+// Flat normals for a triangle soup: every vertex gets its triangle's normal.
+// Triangles are split across numThreads threads (0 = hardware concurrency).
+std::vector<float> compute_normals(const std::vector<float>& vertices, unsigned numThreads = 0);
+
+// Smooth normals from the field gradient, estimated by central differences
+// with offset h (half a cell works well). Works on a soup or on the vertex
+// buffer of an IndexedMesh. Points towards values above the isovalue, which
+// matches the triangle winding. f must be safe to call from several threads.
+// A field with evalBatch (batch_field.h) is sampled through it here.
+std::vector<float> compute_normals_gradient(
+    std::function<float(float, float, float)> f,
+    const std::vector<float>& vertices, float h, unsigned numThreads = 0);
+
+template <typename F>
+std::vector<float> compute_normals_gradient(F&& f, const std::vector<float>& vertices, float h, unsigned numThreads = 0);
+
+#include "marching_cubes_impl.hpp"
 
 #endif
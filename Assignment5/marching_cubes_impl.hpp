@@ -0,0 +1,505 @@
+// Template definitions for marching_cubes.h. The field functor is a template
+// parameter all the way down to the sampling loops, so lambdas get inlined.
+#ifndef MARCHING_CUBES_IMPL_HPP
+#define MARCHING_CUBES_IMPL_HPP
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "TriTable.hpp"
+
+namespace mc_detail {
+
+// Point where the surface crosses the edge from p0 to p1
+inline glm::vec3 interpolateVertex(const glm::vec3& p0, const glm::vec3& p1, float val0, float val1, float isovalue) {
+    // Compute the interpolation factor along the edge
+    float t = (isovalue - val0) / (val1 - val0);
+    t = std::clamp(t, 0.0f, 1.0f);
+
+    return glm::vec3(
+        p0.x + t * (p1.x - p0.x),
+        p0.y + t * (p1.y - p0.y),
+        p0.z + t * (p1.z - p0.z)
+    );
+}
+
+// Classify one cube from its 8 corner values and append its triangles
+inline void march_cell(const glm::vec3 corners[8], const float cubeValues[8], float isovalue, std::vector<float>& vertices) {
+
+    int cubeIndex = 0;
+    for (int i = 0; i < 8; ++i)
+        if (cubeValues[i] < isovalue) cubeIndex |= (1 << i);
+
+    // Cubes entirely inside or outside the isosurface have no triangles
+    int count = mcTables.triangleCount[cubeIndex];
+    if (count == 0) return;
+
+    // Interpolate each crossed edge once, even if several triangles use it
+    glm::vec3 crossings[12];
+    for (unsigned mask = mcTables.edgeMask[cubeIndex]; mask != 0; mask &= mask - 1) {
+        int edge = __builtin_ctz(mask);
+        int v0 = edgeVertices[edge][0];
+        int v1 = edgeVertices[edge][1];
+        crossings[edge] = interpolateVertex(corners[v0], corners[v1], cubeValues[v0], cubeValues[v1], isovalue);
+    }
+
+    // The table's triangles are already wound for our corner order
+    const int8_t* edges = &mcTables.edges[mcTables.offset[cubeIndex]];
+    size_t base = vertices.size();
+    vertices.resize(base + count * 9);
+    float* out = &vertices[base];
+    for (int i = 0; i < count * 3; i++, out += 3) {
+        const glm::vec3& p = crossings[edges[i]];
+        out[0] = p.x;
+        out[1] = p.y;
+        out[2] = p.z;
+    }
+}
+
+// Lattice coordinates along one axis: n cells give n + 1 points at
+// min + i * step. Computing each point from its index (instead of adding
+// step repeatedly) keeps the cell count and positions free of drift.
+inline std::vector<float> lattice_axis(float min, float max, int n) {
+    std::vector<float> axis;
+    if (n <= 0) return axis;
+
+    float step = (max - min) / n;
+    axis.resize(n + 1);
+    for (int i = 0; i <= n; i++)
+        axis[i] = min + i * step;
+    return axis;
+}
+
+// True when F has the evalBatch member described in batch_field.h
+template <typename F, typename = void>
+struct has_batch : std::false_type {};
+
+template <typename F>
+struct has_batch<F, std::void_t<decltype(std::declval<const F&>().evalBatch(
+    (const float*)nullptr, (const float*)nullptr, (const float*)nullptr, (float*)nullptr, size_t(0)))>>
+    : std::true_type {};
+
+// Sample f over one z plane of the lattice. This always calls operator(),
+// even on a batch field, so every extractor sees the same values as
+// marching_cubes and their output matches it bit for bit.
+template <typename F>
+void sample_slice(F& f, const std::vector<float>& xs, const std::vector<float>& ys, float z, std::vector<float>& slice) {
+    size_t nx = xs.size();
+    for (size_t j = 0; j < ys.size(); j++)
+        for (size_t i = 0; i < nx; i++)
+            slice[j * nx + i] = f(xs[i], ys[j], z);
+}
+
+// March the cells between lattice planes kBegin and kEnd, calling f at all 8
+// corners of every cell
+template <typename F>
+void march_slab(
+    F& f, float isovalue,
+    const std::vector<float>& xs, const std::vector<float>& ys, const std::vector<float>& zs,
+    size_t kBegin, size_t kEnd, std::vector<float>& vertices) {
+
+    for (size_t k = kBegin; k < kEnd; k++) {
+        float z = zs[k];
+        for (size_t j = 0; j + 1 < ys.size(); j++) {
+            float y = ys[j];
+            for (size_t i = 0; i + 1 < xs.size(); i++) {
+                float x = xs[i];
+
+                float cubeValues[8];
+                glm::vec3 corners[8] = {
+                    {x, y, z}, {xs[i + 1], y, z}, {xs[i + 1], ys[j + 1], z}, {x, ys[j + 1], z},
+                    {x, y, zs[k + 1]}, {xs[i + 1], y, zs[k + 1]}, {xs[i + 1], ys[j + 1], zs[k + 1]}, {x, ys[j + 1], zs[k + 1]}
+                };
+
+                // Get scalar values at the 8 cube corners
+                for (int c = 0; c < 8; c++) {
+                    cubeValues[c] = f(corners[c].x, corners[c].y, corners[c].z);
+                }
+
+                march_cell(corners, cubeValues, isovalue, vertices);
+            }
+        }
+    }
+}
+
+// Same as march_slab, but every lattice point is sampled once into a rolling
+// pair of z slices, and the cube corners are read back from them
+template <typename F>
+void march_slab_cached(
+    F& f, float isovalue,
+    const std::vector<float>& xs, const std::vector<float>& ys, const std::vector<float>& zs,
+    size_t kBegin, size_t kEnd, std::vector<float>& vertices) {
+
+    size_t nx = xs.size();
+    std::vector<float> below(nx * ys.size()), above(nx * ys.size());
+
+    sample_slice(f, xs, ys, zs[kBegin], below);
+
+    for (size_t k = kBegin; k < kEnd; k++) {
+        sample_slice(f, xs, ys, zs[k + 1], above);
+
+        float z = zs[k];
+        for (size_t j = 0; j + 1 < ys.size(); j++) {
+            float y = ys[j];
+            const float* b0 = &below[j * nx];
+            const float* b1 = &below[(j + 1) * nx];
+            const float* a0 = &above[j * nx];
+            const float* a1 = &above[(j + 1) * nx];
+
+            for (size_t i = 0; i + 1 < nx; i++) {
+                float x = xs[i];
+
+                float cubeValues[8] = {
+                    b0[i], b0[i + 1], b1[i + 1], b1[i],
+                    a0[i], a0[i + 1], a1[i + 1], a1[i]
+                };
+                glm::vec3 corners[8] = {
+                    {x, y, z}, {xs[i + 1], y, z}, {xs[i + 1], ys[j + 1], z}, {x, ys[j + 1], z},
+                    {x, y, zs[k + 1]}, {xs[i + 1], y, zs[k + 1]}, {xs[i + 1], ys[j + 1], zs[k + 1]}, {x, ys[j + 1], zs[k + 1]}
+                };
+
+                march_cell(corners, cubeValues, isovalue, vertices);
+            }
+        }
+
+        std::swap(below, above);
+    }
+}
+
+// Lattice offset (di, dj, dk) and axis (0 = x, 1 = y, 2 = z) of each cube
+// edge, measured from its lower corner. An edge is identified by the lattice
+// point it starts from and its axis, so neighbouring cells find the same one.
+static const int edgeLattice[12][4] = {
+    {0, 0, 0, 0}, {1, 0, 0, 1}, {0, 1, 0, 0}, {0, 0, 0, 1},
+    {0, 0, 1, 0}, {1, 0, 1, 1}, {0, 1, 1, 0}, {0, 0, 1, 1},
+    {0, 0, 0, 2}, {1, 0, 0, 2}, {1, 1, 0, 2}, {0, 1, 0, 2}
+};
+
+static const uint32_t NO_VERTEX = UINT32_MAX;
+
+// Sample-once marching with vertex welding. Vertex ids for the x and y edges
+// of the bottom and top planes and the z edges in between are cached, and the
+// top plane's cache becomes the bottom one for the next layer of cells.
+template <typename F>
+void march_indexed(
+    F& f, float isovalue,
+    const std::vector<float>& xs, const std::vector<float>& ys, const std::vector<float>& zs,
+    IndexedMesh& mesh) {
+
+    size_t nx = xs.size(), ny = ys.size();
+    std::vector<float> below(nx * ny), above(nx * ny);
+
+    // edgeCache[plane][axis] for the x/y edges of the bottom (0) and top (1)
+    // planes; zCache holds the vertical edges of the current layer
+    std::vector<uint32_t> edgeCache[2][2];
+    for (auto& plane : edgeCache)
+        for (auto& axis : plane)
+            axis.assign(nx * ny, NO_VERTEX);
+    std::vector<uint32_t> zCache(nx * ny);
+
+    sample_slice(f, xs, ys, zs[0], below);
+
+    for (size_t k = 0; k + 1 < zs.size(); k++) {
+        sample_slice(f, xs, ys, zs[k + 1], above);
+        std::fill(zCache.begin(), zCache.end(), NO_VERTEX);
+
+        float z = zs[k];
+        for (size_t j = 0; j + 1 < ny; j++) {
+            float y = ys[j];
+            const float* b0 = &below[j * nx];
+            const float* b1 = &below[(j + 1) * nx];
+            const float* a0 = &above[j * nx];
+            const float* a1 = &above[(j + 1) * nx];
+
+            for (size_t i = 0; i + 1 < nx; i++) {
+                float cubeValues[8] = {
+                    b0[i], b0[i + 1], b1[i + 1], b1[i],
+                    a0[i], a0[i + 1], a1[i + 1], a1[i]
+                };
+
+                int cubeIndex = 0;
+                for (int c = 0; c < 8; ++c)
+                    if (cubeValues[c] < isovalue) cubeIndex |= (1 << c);
+
+                int count = mcTables.triangleCount[cubeIndex];
+                if (count == 0) continue;
+
+                float x = xs[i];
+                glm::vec3 corners[8] = {
+                    {x, y, z}, {xs[i + 1], y, z}, {xs[i + 1], ys[j + 1], z}, {x, ys[j + 1], z},
+                    {x, y, zs[k + 1]}, {xs[i + 1], y, zs[k + 1]}, {xs[i + 1], ys[j + 1], zs[k + 1]}, {x, ys[j + 1], zs[k + 1]}
+                };
+
+                // Same winding as march_cell, which the table already has
+                const int8_t* edges = &mcTables.edges[mcTables.offset[cubeIndex]];
+                for (int e = 0; e < count * 3; e++) {
+                    int edge = edges[e];
+                    const int* l = edgeLattice[edge];
+                    size_t slot = (j + l[1]) * nx + (i + l[0]);
+                    uint32_t& id = l[3] == 2 ? zCache[slot] : edgeCache[l[2]][l[3]][slot];
+
+                    if (id == NO_VERTEX) {
+                        int v0 = edgeVertices[edge][0];
+                        int v1 = edgeVertices[edge][1];
+                        glm::vec3 p = interpolateVertex(corners[v0], corners[v1], cubeValues[v0], cubeValues[v1], isovalue);
+                        id = (uint32_t)(mesh.vertices.size() / 3);
+                        mesh.vertices.push_back(p.x);
+                        mesh.vertices.push_back(p.y);
+                        mesh.vertices.push_back(p.z);
+                    }
+                    mesh.indices.push_back(id);
+                }
+            }
+        }
+
+        std::swap(below, above);
+        for (int axis = 0; axis < 2; axis++) {
+            std::swap(edgeCache[0][axis], edgeCache[1][axis]);
+            std::fill(edgeCache[1][axis].begin(), edgeCache[1][axis].end(), NO_VERTEX);
+        }
+    }
+}
+
+// Split [0, n) into chunks of at least minChunk items and run fn(begin, end)
+// on them from a few threads (0 = hardware concurrency). Small jobs stay on
+// the calling thread.
+template <typename Fn>
+void parallel_ranges(size_t n, unsigned numThreads, Fn fn, size_t minChunk = 4096) {
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    if (numThreads == 1 || n <= minChunk) {
+        fn(0, n);
+        return;
+    }
+
+    size_t numChunks = std::min((size_t)numThreads * 4, (n + minChunk - 1) / minChunk);
+    size_t chunkSize = (n + numChunks - 1) / numChunks;
+    std::atomic<size_t> nextChunk(0);
+
+    auto worker = [&]() {
+        for (size_t c = nextChunk++; c * chunkSize < n; c = nextChunk++)
+            fn(c * chunkSize, std::min(n, (c + 1) * chunkSize));
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < std::min((size_t)numThreads, numChunks); t++)
+        pool.emplace_back(worker);
+    for (auto& t : pool)
+        t.join();
+}
+
+// Gradient normals for vertices [begin, end). The positions are split into
+// x, y, z arrays so a batch field can take 6 calls per chunk of vertices.
+template <typename F>
+void gradient_normals(F& f, const float* v, float* n, size_t begin, size_t end, float h) {
+    const size_t chunk = 256;
+    float px[chunk], py[chunk], pz[chunk], shifted[chunk], plus[chunk], minus[chunk];
+    float g[3][chunk];
+
+    for (size_t c = begin; c < end; c += chunk) {
+        size_t count = std::min(chunk, end - c);
+        for (size_t i = 0; i < count; i++) {
+            px[i] = v[(c + i) * 3];
+            py[i] = v[(c + i) * 3 + 1];
+            pz[i] = v[(c + i) * 3 + 2];
+        }
+
+        // Central difference along each axis
+        float* axes[3] = {px, py, pz};
+        for (int a = 0; a < 3; a++) {
+            const float* x = a == 0 ? shifted : px;
+            const float* y = a == 1 ? shifted : py;
+            const float* z = a == 2 ? shifted : pz;
+
+            for (size_t i = 0; i < count; i++) shifted[i] = axes[a][i] + h;
+            if constexpr (has_batch<std::decay_t<F>>::value) {
+                f.evalBatch(x, y, z, plus, count);
+            }
+            else {
+                for (size_t i = 0; i < count; i++) plus[i] = f(x[i], y[i], z[i]);
+            }
+
+            for (size_t i = 0; i < count; i++) shifted[i] = axes[a][i] - h;
+            if constexpr (has_batch<std::decay_t<F>>::value) {
+                f.evalBatch(x, y, z, minus, count);
+            }
+            else {
+                for (size_t i = 0; i < count; i++) minus[i] = f(x[i], y[i], z[i]);
+            }
+
+            for (size_t i = 0; i < count; i++) g[a][i] = plus[i] - minus[i];
+        }
+
+        // The 1 / 2h factor cancels when normalizing
+        for (size_t i = 0; i < count; i++) {
+            float len = std::sqrt(g[0][i] * g[0][i] + g[1][i] * g[1][i] + g[2][i] * g[2][i]);
+            float inv = len > 0.0f ? 1.0f / len : 0.0f;
+            n[(c + i) * 3] = g[0][i] * inv;
+            n[(c + i) * 3 + 1] = g[1][i] * inv;
+            n[(c + i) * 3 + 2] = g[2][i] * inv;
+        }
+    }
+}
+
+} // namespace mc_detail
+
+template <typename F>
+std::vector<float> compute_normals_gradient(F&& f, const std::vector<float>& vertices, float h, unsigned numThreads) {
+    std::vector<float> normals(vertices.size());
+    size_t numVertices = vertices.size() / 3;
+
+    mc_detail::parallel_ranges(numVertices, numThreads, [&](size_t begin, size_t end) {
+        mc_detail::gradient_normals(f, vertices.data(), normals.data(), begin, end, h);
+    });
+
+    return normals;
+}
+
+template <typename F>
+std::vector<float> marching_cubes(F&& f, float isovalue, const Grid& grid) {
+
+    std::vector<float> vertices;
+    std::vector<float> xs = mc_detail::lattice_axis(grid.minX, grid.maxX, grid.nx);
+    std::vector<float> ys = mc_detail::lattice_axis(grid.minY, grid.maxY, grid.ny);
+    std::vector<float> zs = mc_detail::lattice_axis(grid.minZ, grid.maxZ, grid.nz);
+    if (xs.empty() || ys.empty() || zs.empty()) return vertices;
+
+    mc_detail::march_slab(f, isovalue, xs, ys, zs, 0, grid.nz, vertices);
+
+    return vertices;
+}
+
+template <typename F>
+std::vector<float> marching_cubes_cached(F&& f, float isovalue, const Grid& grid) {
+
+    std::vector<float> vertices;
+    std::vector<float> xs = mc_detail::lattice_axis(grid.minX, grid.maxX, grid.nx);
+    std::vector<float> ys = mc_detail::lattice_axis(grid.minY, grid.maxY, grid.ny);
+    std::vector<float> zs = mc_detail::lattice_axis(grid.minZ, grid.maxZ, grid.nz);
+    if (xs.empty() || ys.empty() || zs.empty()) return vertices;
+
+    mc_detail::march_slab_cached(f, isovalue, xs, ys, zs, 0, grid.nz, vertices);
+
+    return vertices;
+}
+
+template <typename F>
+std::vector<float> marching_cubes_parallel(F&& f, float isovalue, const Grid& grid, unsigned numThreads) {
+
+    std::vector<float> xs = mc_detail::lattice_axis(grid.minX, grid.maxX, grid.nx);
+    std::vector<float> ys = mc_detail::lattice_axis(grid.minY, grid.maxY, grid.ny);
+    std::vector<float> zs = mc_detail::lattice_axis(grid.minZ, grid.maxZ, grid.nz);
+    if (xs.empty() || ys.empty() || zs.empty()) return std::vector<float>();
+    size_t numCells = grid.nz;
+
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Hand out more slabs than threads so uneven slabs balance out
+    size_t numSlabs = std::min(numCells, (size_t)numThreads * 4);
+    if (numSlabs <= 1 || numThreads == 1)
+        return marching_cubes_cached<F&>(f, isovalue, grid);
+
+    size_t planesPerSlab = (numCells + numSlabs - 1) / numSlabs;
+    numSlabs = (numCells + planesPerSlab - 1) / planesPerSlab;
+
+    std::vector<std::vector<float>> slabVertices(numSlabs);
+    std::atomic<size_t> nextSlab(0);
+
+    // Each slab samples its own bottom plane, so only the planes shared
+    // between two slabs are evaluated twice
+    auto worker = [&]() {
+        for (size_t s = nextSlab++; s < numSlabs; s = nextSlab++) {
+            size_t begin = s * planesPerSlab;
+            size_t end = std::min(begin + planesPerSlab, numCells);
+            mc_detail::march_slab_cached(f, isovalue, xs, ys, zs, begin, end, slabVertices[s]);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < std::min((size_t)numThreads, numSlabs); t++)
+        pool.emplace_back(worker);
+    for (auto& t : pool)
+        t.join();
+
+    // Concatenate in slab order so the result matches the serial path
+    size_t total = 0;
+    for (const auto& v : slabVertices)
+        total += v.size();
+
+    std::vector<float> vertices;
+    vertices.reserve(total);
+    for (const auto& v : slabVertices)
+        vertices.insert(vertices.end(), v.begin(), v.end());
+
+    return vertices;
+}
+
+template <typename F>
+IndexedMesh marching_cubes_indexed(F&& f, float isovalue, const Grid& grid) {
+
+    IndexedMesh mesh;
+    std::vector<float> xs = mc_detail::lattice_axis(grid.minX, grid.maxX, grid.nx);
+    std::vector<float> ys = mc_detail::lattice_axis(grid.minY, grid.maxY, grid.ny);
+    std::vector<float> zs = mc_detail::lattice_axis(grid.minZ, grid.maxZ, grid.nz);
+    if (xs.empty() || ys.empty() || zs.empty()) return mesh;
+
+    mc_detail::march_indexed(f, isovalue, xs, ys, zs, mesh);
+
+    return mesh;
+}
+
+template <typename F>
+size_t marching_cubes_stream(F&& f, float isovalue, const Grid& grid, const TriangleSink& sink, int slabCells) {
+
+    std::vector<float> xs = mc_detail::lattice_axis(grid.minX, grid.maxX, grid.nx);
+    std::vector<float> ys = mc_detail::lattice_axis(grid.minY, grid.maxY, grid.ny);
+    std::vector<float> zs = mc_detail::lattice_axis(grid.minZ, grid.maxZ, grid.nz);
+    if (xs.empty() || ys.empty() || zs.empty()) return 0;
+
+    slabCells = std::max(1, slabCells);
+    size_t numTriangles = 0;
+    std::vector<float> batch;
+
+    for (int begin = 0; begin < grid.nz; begin += slabCells) {
+        int end = std::min(begin + slabCells, grid.nz);
+
+        batch.clear();
+        mc_detail::march_slab_cached(f, isovalue, xs, ys, zs, begin, end, batch);
+        if (batch.empty()) continue;
+
+        if (!sink(batch)) break;
+        numTriangles += batch.size() / 9;
+    }
+
+    return numTriangles;
+}
+
+// The cube-shaped (min, max, stepsize) forms
+
+template <typename F>
+std::vector<float> marching_cubes(F&& f, float isovalue, float min, float max, float stepsize) {
+    return marching_cubes<F&>(f, isovalue, make_grid(min, max, stepsize));
+}
+
+template <typename F>
+std::vector<float> marching_cubes_cached(F&& f, float isovalue, float min, float max, float stepsize) {
+    return marching_cubes_cached<F&>(f, isovalue, make_grid(min, max, stepsize));
+}
+
+template <typename F>
+std::vector<float> marching_cubes_parallel(F&& f, float isovalue, float min, float max, float stepsize, unsigned numThreads) {
+    return marching_cubes_parallel<F&>(f, isovalue, make_grid(min, max, stepsize), numThreads);
+}
+
+template <typename F>
+IndexedMesh marching_cubes_indexed(F&& f, float isovalue, float min, float max, float stepsize) {
+    return marching_cubes_indexed<F&>(f, isovalue, make_grid(min, max, stepsize));
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "ply_writer.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+void writePLY(const vector<float>& vertices, const vector<float>& normals, const string& fileName) {
+    ofstream outFile(fileName);
+
+    if (!outFile) {
+        cerr << "Error opening file: " << fileName << endl;
+        return;
+    }
+
+    // Write PLY header
+    outFile << "ply\n\n";
+    outFile << "format ascii 1.0\n";
+    outFile << "element vertex " << vertices.size() / 3 << "\n";
+    outFile << "property float x\n";
+    outFile << "property float y\n";
+    outFile << "property float z\n";
+    outFile << "property float nx\n";
+    outFile << "property float ny\n";
+    outFile << "property float nz\n";
+    outFile << "element face " << vertices.size() / 3 / 3 << "\n";
+    outFile << "property list uchar int vertex_index\n";
+    outFile << "end_header\n\n";
+
+    // Write vertices and normals
+    for (size_t i = 0; i < vertices.size() / 3; ++i) {
+        outFile << vertices[i * 3] << " " << vertices[i * 3 + 1] << " " << vertices[i * 3 + 2] << " ";
+        outFile << normals[i * 3] << " " << normals[i * 3 + 1] << " " << normals[i * 3 + 2] << "\n";
+    }
+
+    // Write faces (triangles)
+    for (size_t i = 0; i < vertices.size() / 3 / 3; ++i) {
+        outFile << "3 " << i * 3 << " " << i * 3 + 1 << " " << i * 3 + 2 << "\n";
+    }
+
+    outFile.close();
+}
+
+// Bytes are packed into this buffer and written once it fills up
+static const size_t PLY_BUFFER_SIZE = 1 << 20;
+
+static bool hostIsLittleEndian() {
+    uint16_t one = 1;
+    unsigned char firstByte;
+    memcpy(&firstByte, &one, 1);
+    return firstByte == 1;
+}
+
+// Append a 4 byte value in little endian order
+static inline unsigned char* put32(unsigned char* out, const void* value, bool swapBytes) {
+    memcpy(out, value, 4);
+    if (swapBytes) {
+        swap(out[0], out[3]);
+        swap(out[1], out[2]);
+    }
+    return out + 4;
+}
+
+// Counts are zero-padded to countWidth digits when given, so a streamed
+// header can be rewritten in place with the final counts
+static string paddedCount(size_t count, int countWidth) {
+    string digits = to_string(count);
+    if ((int)digits.size() < countWidth)
+        digits.insert(0, countWidth - digits.size(), '0');
+    return digits;
+}
+
+static string binaryPLYHeader(size_t numVertices, size_t numFaces, int countWidth = 0) {
+    string header = "ply\n";
+    header += "format binary_little_endian 1.0\n";
+    header += "element vertex " + paddedCount(numVertices, countWidth) + "\n";
+    header += "property float x\n";
+    header += "property float y\n";
+    header += "property float z\n";
+    header += "property float nx\n";
+    header += "property float ny\n";
+    header += "property float nz\n";
+    header += "element face " + paddedCount(numFaces, countWidth) + "\n";
+    header += "property list uchar uint vertex_index\n";
+    header += "end_header\n";
+    return header;
+}
+
+// Interleave positions and normals into 24 byte vertex records
+static bool writeVertexBlock(FILE* file, const float* vertices, const float* normals, size_t numVertices) {
+    const size_t recordSize = 6 * sizeof(float);
+    const size_t perChunk = PLY_BUFFER_SIZE / recordSize;
+    bool swapBytes = !hostIsLittleEndian();
+    vector<unsigned char> buffer(perChunk * recordSize);
+
+    for (size_t first = 0; first < numVertices; first += perChunk) {
+        size_t count = std::min(perChunk, numVertices - first);
+
+        if (!swapBytes) {
+            // Same byte order, so the floats can be copied as they are
+            float* out = reinterpret_cast<float*>(buffer.data());
+            for (size_t i = 0; i < count; i++) {
+                memcpy(out + i * 6, vertices + (first + i) * 3, 3 * sizeof(float));
+                memcpy(out + i * 6 + 3, normals + (first + i) * 3, 3 * sizeof(float));
+            }
+        }
+        else {
+            unsigned char* out = buffer.data();
+            for (size_t i = 0; i < count; i++) {
+                for (int c = 0; c < 3; c++) out = put32(out, vertices + (first + i) * 3 + c, true);
+                for (int c = 0; c < 3; c++) out = put32(out, normals + (first + i) * 3 + c, true);
+            }
+        }
+
+        if (fwrite(buffer.data(), recordSize, count, file) != count)
+            return false;
+    }
+    return true;
+}
+
+// 13 byte face records: a uchar count of 3 and three uint indices. If indices
+// is null, face i uses vertices 3i, 3i + 1 and 3i + 2.
+static bool writeFaceBlock(FILE* file, const uint32_t* indices, size_t numFaces) {
+    const size_t recordSize = 1 + 3 * sizeof(uint32_t);
+    const size_t perChunk = PLY_BUFFER_SIZE / recordSize;
+    bool swapBytes = !hostIsLittleEndian();
+    vector<unsigned char> buffer(perChunk * recordSize);
+
+    for (size_t first = 0; first < numFaces; first += perChunk) {
+        size_t count = std::min(perChunk, numFaces - first);
+
+        unsigned char* out = buffer.data();
+        for (size_t f = first; f < first + count; f++) {
+            *out++ = 3;
+            for (int c = 0; c < 3; c++) {
+                uint32_t index = indices ? indices[f * 3 + c] : (uint32_t)(f * 3 + c);
+                out = put32(out, &index, swapBytes);
+            }
+        }
+
+        if (fwrite(buffer.data(), recordSize, count, file) != count)
+            return false;
+    }
+    return true;
+}
+
+// Faces store 32 bit indices, so no vertex past this one can be referenced
+static const size_t PLY_MAX_VERTICES = UINT32_MAX;
+
+static bool writeBinary(const string& fileName, const float* vertices, const float* normals, size_t numVertices,
+    const uint32_t* indices, size_t numFaces) {
+
+    if (numVertices > PLY_MAX_VERTICES) {
+        cerr << "writePLYBinary: " << numVertices << " vertices is more than a uint index can address" << endl;
+        return false;
+    }
+
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (!file) {
+        cerr << "Error opening file: " << fileName << endl;
+        return false;
+    }
+
+    string header = binaryPLYHeader(numVertices, numFaces);
+    bool ok = fwrite(header.data(), 1, header.size(), file) == header.size()
+        && writeVertexBlock(file, vertices, normals, numVertices)
+        && writeFaceBlock(file, indices, numFaces);
+
+    if (fclose(file) != 0) ok = false;
+    if (!ok) cerr << "Error writing file: " << fileName << endl;
+    return ok;
+}
+
+bool writePLYBinary(const vector<float>& vertices, const vector<float>& normals, const string& fileName) {
+    if (normals.size() != vertices.size()) {
+        cerr << "writePLYBinary: need one normal per vertex" << endl;
+        return false;
+    }
+    return writeBinary(fileName, vertices.data(), normals.data(), vertices.size() / 3, nullptr, vertices.size() / 9);
+}
+
+bool writePLYBinary(const IndexedMesh& mesh, const vector<float>& normals, const string& fileName) {
+    if (normals.size() != mesh.vertices.size()) {
+        cerr << "writePLYBinary: need one normal per vertex" << endl;
+        return false;
+    }
+    return writeBinary(fileName, mesh.vertices.data(), normals.data(), mesh.vertices.size() / 3,
+        mesh.indices.data(), mesh.indices.size() / 3);
+}
+
+// Wide enough for any count a 32 bit index can reach
+static const int STREAM_COUNT_WIDTH = 10;
+
+PLYStreamWriter::~PLYStreamWriter() {
+    if (file) close();
+}
+
+bool PLYStreamWriter::open(const string& fileName) {
+    if (file) close();
+
+    name = fileName;
+    numVertices = 0;
+    ok = true;
+
+    file = fopen(fileName.c_str(), "wb");
+    if (!file) {
+        cerr << "Error opening file: " << fileName << endl;
+        ok = false;
+        return false;
+    }
+
+    string header = binaryPLYHeader(0, 0, STREAM_COUNT_WIDTH);
+    ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+    return ok;
+}
+
+bool PLYStreamWriter::addTriangles(const vector<float>& vertices, const vector<float>& normals) {
+    if (!file || !ok) return false;
+    if (normals.size() != vertices.size()) {
+        cerr << "PLYStreamWriter: need one normal per vertex" << endl;
+        return false;
+    }
+
+    size_t count = vertices.size() / 3;
+    if (count > PLY_MAX_VERTICES - numVertices) {
+        cerr << "PLYStreamWriter: more vertices than a uint index can address" << endl;
+        ok = false;
+        return false;
+    }
+
+    ok = writeVertexBlock(file, vertices.data(), normals.data(), count);
+    numVertices += count;
+    return ok;
+}
+
+bool PLYStreamWriter::close() {
+    if (!file) return false;
+
+    ok = ok && writeFaceBlock(file, nullptr, numVertices / 3);
+
+    // Patch the counts; the padded header keeps the same length
+    if (ok) {
+        string header = binaryPLYHeader(numVertices, numVertices / 3, STREAM_COUNT_WIDTH);
+        ok = fseek(file, 0, SEEK_SET) == 0
+            && fwrite(header.data(), 1, header.size(), file) == header.size();
+    }
+
+    if (fclose(file) != 0) ok = false;
+    file = nullptr;
+
+    if (!ok) cerr << "Error writing file: " << name << endl;
+    return ok;
+}
+
+TriangleSink plyStreamSink(PLYStreamWriter& writer) {
+    return [&writer](const vector<float>& triangles) {
+        return writer.addTriangles(triangles, compute_normals(triangles, 1));
+    };
+}
@@ -0,0 +1,57 @@
+#ifndef PLY_WRITER_H
+#define PLY_WRITER_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "marching_cubes.h"
+
+// ASCII PLY of a triangle soup, one line per vertex and per face
+void writePLY(const std::vector<float>& vertices, const std::vector<float>& normals, const std::string& fileName);
+
+// binary_little_endian 1.0 PLY with x, y, z, nx, ny, nz float vertices and
+// "list uchar uint" faces. The vertex and face blocks are packed into a large
+// buffer and written with a few fwrite calls. Returns false if the file could
+// not be written.
+bool writePLYBinary(const std::vector<float>& vertices, const std::vector<float>& normals, const std::string& fileName);
+
+// Same, but for an indexed mesh: one PLY vertex per mesh vertex and the faces
+// taken from the index buffer
+bool writePLYBinary(const IndexedMesh& mesh, const std::vector<float>& normals, const std::string& fileName);
+
+// Writes a binary PLY triangle soup piece by piece, so a mesh larger than
+// memory can go straight to disk. The header is written first with
+// fixed-width, zero-padded counts and patched with the real counts in close().
+// The faces are sequential, so close() generates them from the triangle count.
+class PLYStreamWriter {
+public:
+    PLYStreamWriter() {}
+    ~PLYStreamWriter();
+
+    PLYStreamWriter(const PLYStreamWriter&) = delete;
+    PLYStreamWriter& operator=(const PLYStreamWriter&) = delete;
+
+    bool open(const std::string& fileName);
+
+    // Append triangles with one normal per vertex. Fails once the file would
+    // hold more vertices than a uint index can address.
+    bool addTriangles(const std::vector<float>& vertices, const std::vector<float>& normals);
+
+    // Write the faces and the final counts. Returns false if anything failed.
+    bool close();
+
+    size_t triangleCount() const { return numVertices / 3; }
+
+private:
+    FILE* file = nullptr;
+    std::string name;
+    size_t numVertices = 0;
+    bool ok = true;
+};
+
+// A sink for marching_cubes_stream that computes flat normals for each
+// batch and appends it to writer. It stops the extraction once a write fails.
+TriangleSink plyStreamSink(PLYStreamWriter& writer);
+
+#endif
@@ -0,0 +1,68 @@
+#include "remesher.h"
+
+using namespace std;
+
+BackgroundMesher::BackgroundMesher(Job job) : job(job) {
+    worker = thread(&BackgroundMesher::run, this);
+}
+
+BackgroundMesher::~BackgroundMesher() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void BackgroundMesher::request(const MeshParams& params) {
+    {
+        lock_guard<mutex> guard(lock);
+        pending = params;
+        hasRequest = true;
+    }
+    wake.notify_one();
+}
+
+bool BackgroundMesher::poll(MeshParams& params, vector<float>& vertices, vector<float>& normals) {
+    lock_guard<mutex> guard(lock);
+    if (!hasResult) return false;
+
+    params = resultParams;
+    vertices = std::move(resultVertices);
+    normals = std::move(resultNormals);
+    hasResult = false;
+    return true;
+}
+
+bool BackgroundMesher::busy() {
+    lock_guard<mutex> guard(lock);
+    return hasRequest || working;
+}
+
+void BackgroundMesher::run() {
+    while (true) {
+        MeshParams params;
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [this]() { return stopping || hasRequest; });
+            if (stopping) return;
+
+            params = pending;
+            hasRequest = false;
+            working = true;
+        }
+
+        // The slow part runs without holding the lock
+        vector<float> vertices, normals;
+        job(params, vertices, normals);
+
+        // Replaces a result that was never polled, since this one is newer
+        lock_guard<mutex> guard(lock);
+        working = false;
+        resultParams = params;
+        resultVertices = std::move(vertices);
+        resultNormals = std::move(normals);
+        hasResult = true;
+    }
+}
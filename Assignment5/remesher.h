@@ -0,0 +1,60 @@
+#ifndef REMESHER_H
+#define REMESHER_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Everything the viewer lets the user change about the extraction
+struct MeshParams {
+    float isovalue = 0.0f;
+    float min = -1.5f;
+    float max = 1.5f;
+    float stepsize = 0.1f;
+    float keepRatio = 1.0f;       // fraction of the triangles simplify_mesh keeps; 1 skips it
+};
+
+// Runs mesh extraction on a worker thread so the render loop never waits for
+// it. request() hands over new parameters (only the latest pending request is
+// kept), and poll() returns a finished mesh once, without blocking. Every
+// finished mesh is handed out even if newer parameters are already pending,
+// so a held key still shows progress instead of nothing until it is released.
+class BackgroundMesher {
+public:
+    typedef std::function<void(const MeshParams& params, std::vector<float>& vertices, std::vector<float>& normals)> Job;
+
+    explicit BackgroundMesher(Job job);
+    ~BackgroundMesher();
+
+    BackgroundMesher(const BackgroundMesher&) = delete;
+    BackgroundMesher& operator=(const BackgroundMesher&) = delete;
+
+    void request(const MeshParams& params);
+
+    // Moves the newest finished mesh out. Returns false if there is none.
+    bool poll(MeshParams& params, std::vector<float>& vertices, std::vector<float>& normals);
+
+    // True while a request is pending or being meshed
+    bool busy();
+
+private:
+    Job job;
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+
+    bool stopping = false;
+    bool hasRequest = false;
+    bool working = false;
+    MeshParams pending;
+
+    bool hasResult = false;
+    MeshParams resultParams;
+    std::vector<float> resultVertices, resultNormals;
+
+    void run();
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "sampled_grid.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+SampledGrid sample_grid(function<float(float, float, float)> f, const Grid& grid) {
+    return sample_grid<const ScalarField&>(f, grid);
+}
+
+MinMaxBricks build_min_max_bricks(const SampledGrid& volume, int brickSize) {
+    const Grid& g = volume.grid;
+
+    MinMaxBricks bricks;
+    bricks.brickSize = brickSize;
+    bricks.bx = (g.nx + brickSize - 1) / brickSize;
+    bricks.by = (g.ny + brickSize - 1) / brickSize;
+    bricks.bz = (g.nz + brickSize - 1) / brickSize;
+
+    size_t numBricks = (size_t)bricks.bx * bricks.by * bricks.bz;
+    bricks.minValues.assign(numBricks, INFINITY);
+    bricks.maxValues.assign(numBricks, -INFINITY);
+
+    // Walk the samples once. A lattice point on a brick boundary belongs to
+    // both neighbouring bricks, so it updates each brick it touches.
+    for (int k = 0; k <= g.nz; k++) {
+        int bk0 = std::min(k / brickSize, bricks.bz - 1);
+        int bk1 = (k % brickSize == 0 && k > 0) ? k / brickSize - 1 : bk0;
+
+        for (int j = 0; j <= g.ny; j++) {
+            int bj0 = std::min(j / brickSize, bricks.by - 1);
+            int bj1 = (j % brickSize == 0 && j > 0) ? j / brickSize - 1 : bj0;
+
+            for (int i = 0; i <= g.nx; i++) {
+                int bi0 = std::min(i / brickSize, bricks.bx - 1);
+                int bi1 = (i % brickSize == 0 && i > 0) ? i / brickSize - 1 : bi0;
+
+                float v = volume.at(i, j, k);
+                for (int bk : {bk0, bk1})
+                    for (int bj : {bj0, bj1})
+                        for (int bi : {bi0, bi1}) {
+                            size_t b = bricks.index(bi, bj, bk);
+                            bricks.minValues[b] = std::min(bricks.minValues[b], v);
+                            bricks.maxValues[b] = std::max(bricks.maxValues[b], v);
+                        }
+            }
+        }
+    }
+
+    return bricks;
+}
+
+void refresh_brick(const SampledGrid& volume, MinMaxBricks& bricks, int bi, int bj, int bk) {
+    const Grid& g = volume.grid;
+    int B = bricks.brickSize;
+
+    float lo = INFINITY, hi = -INFINITY;
+    for (int k = bk * B; k <= std::min((bk + 1) * B, g.nz); k++)
+        for (int j = bj * B; j <= std::min((bj + 1) * B, g.ny); j++)
+            for (int i = bi * B; i <= std::min((bi + 1) * B, g.nx); i++) {
+                float v = volume.at(i, j, k);
+                lo = std::min(lo, v);
+                hi = std::max(hi, v);
+            }
+
+    size_t b = bricks.index(bi, bj, bk);
+    bricks.minValues[b] = lo;
+    bricks.maxValues[b] = hi;
+}
+
+void march_sampled_cells(
+    const SampledGrid& volume, const vector<float>& xs, const vector<float>& ys, const vector<float>& zs,
+    float isovalue, int i0, int j0, int k0, int i1, int j1, int k1, vector<float>& vertices) {
+
+    for (int k = k0; k < k1; k++) {
+        float z = zs[k];
+        for (int j = j0; j < j1; j++) {
+            float y = ys[j];
+            for (int i = i0; i < i1; i++) {
+                float x = xs[i];
+
+                float cubeValues[8] = {
+                    volume.at(i, j, k), volume.at(i + 1, j, k), volume.at(i + 1, j + 1, k), volume.at(i, j + 1, k),
+                    volume.at(i, j, k + 1), volume.at(i + 1, j, k + 1), volume.at(i + 1, j + 1, k + 1), volume.at(i, j + 1, k + 1)
+                };
+                vec3 corners[8] = {
+                    {x, y, z}, {xs[i + 1], y, z}, {xs[i + 1], ys[j + 1], z}, {x, ys[j + 1], z},
+                    {x, y, zs[k + 1]}, {xs[i + 1], y, zs[k + 1]}, {xs[i + 1], ys[j + 1], zs[k + 1]}, {x, ys[j + 1], zs[k + 1]}
+                };
+
+                mc_detail::march_cell(corners, cubeValues, isovalue, vertices);
+            }
+        }
+    }
+}
+
+vector<float> marching_cubes_sampled(
+    const SampledGrid& volume, float isovalue,
+    const MinMaxBricks* bricks, CullStats* stats) {
+
+    vector<float> vertices;
+    const Grid& g = volume.grid;
+    if (volume.values.empty()) return vertices;
+
+    vector<float> xs = mc_detail::lattice_axis(g.minX, g.maxX, g.nx);
+    vector<float> ys = mc_detail::lattice_axis(g.minY, g.maxY, g.ny);
+    vector<float> zs = mc_detail::lattice_axis(g.minZ, g.maxZ, g.nz);
+
+    CullStats counts;
+    if (bricks) {
+        for (size_t b = 0; b < bricks->minValues.size(); b++) {
+            if (bricks->active(b, isovalue)) counts.bricksActive++;
+            else counts.bricksSkipped++;
+        }
+    }
+
+    // Without bricks every row is one run of cells
+    int runLength = bricks ? bricks->brickSize : g.nx;
+
+    for (int k = 0; k < g.nz; k++) {
+        for (int j = 0; j < g.ny; j++) {
+            for (int run = 0; run < g.nx; run += runLength) {
+                int runEnd = std::min(run + runLength, g.nx);
+
+                if (bricks) {
+                    size_t b = bricks->index(run / runLength, j / runLength, k / runLength);
+                    if (!bricks->active(b, isovalue)) {
+                        counts.cellsSkipped += runEnd - run;
+                        continue;
+                    }
+                }
+                counts.cellsVisited += runEnd - run;
+
+                march_sampled_cells(volume, xs, ys, zs, isovalue, run, j, k, runEnd, j + 1, k + 1, vertices);
+            }
+        }
+    }
+
+    if (stats) *stats = counts;
+    return vertices;
+}
@@ -0,0 +1,87 @@
+#ifndef SAMPLED_GRID_H
+#define SAMPLED_GRID_H
+
+#include <vector>
+#include <functional>
+
+#include "marching_cubes.h"
+
+// A field sampled once at every lattice point of a grid. values holds
+// (nx + 1) * (ny + 1) * (nz + 1) samples with x fastest, then y, then z.
+struct SampledGrid {
+    Grid grid;
+    std::vector<float> values;
+
+    float at(int i, int j, int k) const {
+        return values[((size_t)k * (grid.ny + 1) + j) * (grid.nx + 1) + i];
+    }
+};
+
+// Min and max sample of every brick of brickSize^3 cells. A brick includes
+// the lattice points on its far faces, so it bounds every corner of its cells.
+struct MinMaxBricks {
+    int brickSize = 8;
+    int bx = 0, by = 0, bz = 0;
+    std::vector<float> minValues, maxValues;
+
+    size_t index(int i, int j, int k) const {
+        return ((size_t)k * by + j) * bx + i;
+    }
+
+    // The isosurface can only pass through the brick if its range straddles isovalue
+    bool active(size_t brick, float isovalue) const {
+        return minValues[brick] < isovalue && maxValues[brick] >= isovalue;
+    }
+};
+
+// How much work a sampled extraction did
+struct CullStats {
+    size_t cellsVisited = 0;
+    size_t cellsSkipped = 0;
+    size_t bricksActive = 0;
+    size_t bricksSkipped = 0;
+};
+
+SampledGrid sample_grid(std::function<float(float, float, float)> f, const Grid& grid);
+
+template <typename F>
+SampledGrid sample_grid(F&& f, const Grid& grid) {
+    SampledGrid volume;
+    volume.grid = grid;
+
+    std::vector<float> xs = mc_detail::lattice_axis(grid.minX, grid.maxX, grid.nx);
+    std::vector<float> ys = mc_detail::lattice_axis(grid.minY, grid.maxY, grid.ny);
+    std::vector<float> zs = mc_detail::lattice_axis(grid.minZ, grid.maxZ, grid.nz);
+    if (xs.empty() || ys.empty() || zs.empty()) return volume;
+
+    size_t sliceSize = xs.size() * ys.size();
+    volume.values.resize(sliceSize * zs.size());
+
+    std::vector<float> slice(sliceSize);
+    for (size_t k = 0; k < zs.size(); k++) {
+        mc_detail::sample_slice(f, xs, ys, zs[k], slice);
+        std::copy(slice.begin(), slice.end(), volume.values.begin() + k * sliceSize);
+    }
+
+    return volume;
+}
+
+MinMaxBricks build_min_max_bricks(const SampledGrid& volume, int brickSize = 8);
+
+// Recompute the range of one brick after samples inside it changed
+void refresh_brick(const SampledGrid& volume, MinMaxBricks& bricks, int bi, int bj, int bk);
+
+// Append the triangles of cells [i0, i1) x [j0, j1) x [k0, k1) of a sampled
+// grid. xs, ys, zs are the grid's lattice coordinates.
+void march_sampled_cells(
+    const SampledGrid& volume, const std::vector<float>& xs, const std::vector<float>& ys, const std::vector<float>& zs,
+    float isovalue, int i0, int j0, int k0, int i1, int j1, int k1, std::vector<float>& vertices);
+
+// Triangle soup of the isosurface of a sampled grid, in the same order as
+// marching_cubes over that grid. With bricks, whole runs of cells inside
+// bricks that cannot contain the surface are skipped without being classified.
+std::vector<float> marching_cubes_sampled(
+    const SampledGrid& volume, float isovalue,
+    const MinMaxBricks* bricks = nullptr, CullStats* stats = nullptr);
+
+#endif
@@ -0,0 +1,78 @@
+#include "shader_program.h"
+
+#include <vector>
+
+using namespace std;
+
+void ShaderProgram::attach(GLuint program) {
+    this->program = program;
+    locations.clear();
+    if (!program) return;
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    vector<GLchar> name(maxLength + 1);
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, i, name.size(), &length, &size, &type, name.data());
+
+        // Members of uniform blocks have no location
+        string uniformName(name.data(), length);
+        GLint loc = glGetUniformLocation(program, uniformName.c_str());
+        if (loc < 0) continue;
+
+        locations[uniformName] = loc;
+
+        // Arrays are reported as "name[0]", but are also looked up as "name"
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+            locations[uniformName.substr(0, uniformName.size() - 3)] = loc;
+    }
+}
+
+GLint ShaderProgram::location(const string& name) const {
+    auto it = locations.find(name);
+    return it == locations.end() ? -1 : it->second;
+}
+
+bool ShaderProgram::bindBlock(const char* blockName, GLuint binding) const {
+    GLuint index = glGetUniformBlockIndex(program, blockName);
+    if (index == GL_INVALID_INDEX) return false;
+
+    glUniformBlockBinding(program, index, binding);
+    return true;
+}
+
+UniformBuffer::~UniformBuffer() {
+    release();
+}
+
+void UniformBuffer::create(size_t bytes, GLuint binding) {
+    if (!buffer) glGenBuffers(1, &buffer);
+
+    bindingPoint = binding;
+    size = bytes;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
+
+void UniformBuffer::update(const void* data, size_t bytes, size_t offset) {
+    if (!buffer || offset + bytes > size) return;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, bytes, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::release() {
+    if (buffer) glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    size = 0;
+}
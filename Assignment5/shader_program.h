@@ -0,0 +1,65 @@
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+// A linked program plus the locations of all of its active uniforms, read
+// once when the program is attached. Look locations up once after linking
+// and keep them, instead of calling glGetUniformLocation every frame.
+class ShaderProgram {
+public:
+    ShaderProgram() {}
+    explicit ShaderProgram(GLuint program) { attach(program); }
+
+    // Take a linked program and read its active uniforms
+    void attach(GLuint program);
+
+    GLuint id() const { return program; }
+    void use() const { glUseProgram(program); }
+
+    // -1 if the program has no active uniform with that name, which
+    // glUniform* calls ignore
+    GLint location(const std::string& name) const;
+
+    // Points the named uniform block at a binding point. Returns false if the
+    // program does not use the block.
+    bool bindBlock(const char* blockName, GLuint binding) const;
+
+private:
+    GLuint program = 0;
+    std::unordered_map<std::string, GLint> locations;
+};
+
+// A uniform buffer object bound to a fixed binding point. Every program that
+// binds its block to the same point reads from it, so a whole block of
+// uniforms is updated with one glBufferSubData. The C++ struct written into
+// it has to match the std140 layout of the block.
+class UniformBuffer {
+public:
+    UniformBuffer() {}
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    void create(size_t bytes, GLuint binding);
+    void update(const void* data, size_t bytes, size_t offset = 0);
+
+    template <typename T>
+    void update(const T& block) { update(&block, sizeof(T)); }
+
+    GLuint binding() const { return bindingPoint; }
+
+    // Deletes the buffer. Safe to call more than once.
+    void release();
+
+private:
+    GLuint buffer = 0;
+    GLuint bindingPoint = 0;
+    size_t size = 0;
+};
+
+#endif
@@ -0,0 +1,544 @@
+#include "simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+const uint32_t NONE = 0xffffffffu;
+
+inline uint32_t nextEdge(uint32_t h) { return h % 3 == 2 ? h - 2 : h + 1; }
+inline uint32_t prevEdge(uint32_t h) { return h % 3 == 0 ? h + 2 : h - 1; }
+
+// Symmetric 4x4 quadric, upper triangle row by row: aa ab ac ad bb bc bd cc cd dd
+struct Quadric {
+    double q[10] = {0.0};
+
+    void addPlane(double a, double b, double c, double d) {
+        q[0] += a * a; q[1] += a * b; q[2] += a * c; q[3] += a * d;
+        q[4] += b * b; q[5] += b * c; q[6] += b * d;
+        q[7] += c * c; q[8] += c * d;
+        q[9] += d * d;
+    }
+
+    void add(const Quadric& o) {
+        for (int i = 0; i < 10; i++)
+            q[i] += o.q[i];
+    }
+
+    double error(double x, double y, double z) const {
+        return q[0] * x * x + q[4] * y * y + q[7] * z * z
+            + 2.0 * (q[1] * x * y + q[2] * x * z + q[5] * y * z)
+            + 2.0 * (q[3] * x + q[6] * y + q[8] * z) + q[9];
+    }
+
+    // Point of least error, or false where the planes do not pin one down
+    // (a flat or singly curved patch)
+    bool minimum(double p[3]) const {
+        double c00 = q[4] * q[7] - q[5] * q[5];
+        double c01 = q[2] * q[5] - q[1] * q[7];
+        double c02 = q[1] * q[5] - q[2] * q[4];
+        double det = q[0] * c00 + q[1] * c01 + q[2] * c02;
+
+        double scale = (q[0] + q[4] + q[7]) / 3.0;
+        if (fabs(det) <= 1e-3 * scale * scale * scale) return false;
+
+        double c11 = q[0] * q[7] - q[2] * q[2];
+        double c12 = q[2] * q[1] - q[0] * q[5];
+        double c22 = q[0] * q[4] - q[1] * q[1];
+
+        p[0] = -(c00 * q[3] + c01 * q[6] + c02 * q[8]) / det;
+        p[1] = -(c01 * q[3] + c11 * q[6] + c12 * q[8]) / det;
+        p[2] = -(c02 * q[3] + c12 * q[6] + c22 * q[8]) / det;
+        return true;
+    }
+};
+
+// A queued collapse of the edge starting at half-edge h. Entries are never
+// taken out of the queue early; one is stale unless its cost is still the
+// one recorded for h in queuedCost.
+struct QueueEntry {
+    float cost;
+    uint32_t h;
+};
+
+// Priority queue of collapses, cheapest first. A binary heap spends about
+// half the simplification sifting once the mesh has millions of edges, so the
+// costs go into buckets instead: a float's exponent and top 4 mantissa bits,
+// 16 buckets per doubling of the cost. Push and pop are O(1), and entries
+// within 1/16 of an octave of each other come out newest first, which keeps
+// the work near the last collapse and its vertices in cache.
+class CollapseQueue {
+public:
+    CollapseQueue() : buckets(4096) {}
+
+    bool empty() const { return count == 0; }
+
+    void push(const QueueEntry& e) {
+        size_t b = bucket(e.cost);
+        buckets[b].push_back(e);
+        lowest = std::min(lowest, b);
+        count++;
+    }
+
+    // Only valid while !empty()
+    const QueueEntry& top() {
+        while (buckets[lowest].empty())
+            lowest++;
+        return buckets[lowest].back();
+    }
+
+    void pop() {
+        top();
+        buckets[lowest].pop_back();
+        count--;
+    }
+
+    static size_t bucket(float cost) {
+        if (!(cost > 0.0f)) return 0;
+        uint32_t bits;
+        memcpy(&bits, &cost, sizeof(bits));
+        return std::min<size_t>(bits >> 19, 4095);
+    }
+
+private:
+    vector<vector<QueueEntry>> buckets;
+    size_t lowest = 0;
+    size_t count = 0;
+};
+
+// Everything about one vertex in one place. Collapses jump all over the
+// mesh, so each vertex visited should cost as few cache misses as possible.
+struct VertexState {
+    Quadric quadric;
+    float pos[3];
+    uint32_t edge = NONE;         // one outgoing half-edge
+    uint32_t mark = 0;            // link condition scratch
+    uint8_t locked = 0;           // on a boundary or non-manifold
+};
+
+class Simplifier {
+public:
+    Simplifier(const IndexedMesh& mesh);
+
+    void run(const SimplifyOptions& options, SimplifyStats& stats);
+    IndexedMesh result() const;
+
+private:
+    vector<VertexState> verts;
+    vector<uint32_t> corner;      // vertex each half-edge starts at
+    vector<uint32_t> twin;        // opposite half-edge, or NONE on a boundary
+    vector<uint8_t> removed;      // per triangle
+    vector<float> queuedCost;     // per half-edge, or -1 if it has no live entry
+    size_t triangles = 0;
+
+    uint32_t markStamp = 0;
+    vector<uint32_t> ring0, ring1;
+
+    void outgoing(uint32_t v, vector<uint32_t>& out) const;
+    bool plan(uint32_t& h, double p[3], double& cost) const;
+    bool flips(const vector<uint32_t>& ring, uint32_t t0, uint32_t t1, const double p[3]) const;
+    bool canCollapse(uint32_t h, const double p[3]);
+    void collapse(uint32_t h, const double p[3]);
+    void queueEdge(uint32_t h, CollapseQueue& queue);
+};
+
+Simplifier::Simplifier(const IndexedMesh& mesh) : corner(mesh.indices) {
+    size_t nv = mesh.vertices.size() / 3;
+    size_t nt = corner.size() / 3;
+    corner.resize(nt * 3);
+
+    twin.assign(nt * 3, NONE);
+    removed.assign(nt, 0);
+    queuedCost.assign(nt * 3, -1.0f);
+
+    verts.resize(nv);
+    for (size_t v = 0; v < nv; v++) {
+        for (int i = 0; i < 3; i++)
+            verts[v].pos[i] = mesh.vertices[v * 3 + i];
+    }
+
+    // Drop triangles that repeat a vertex or point past the vertex buffer
+    for (size_t t = 0; t < nt; t++) {
+        uint32_t a = corner[3 * t], b = corner[3 * t + 1], c = corner[3 * t + 2];
+        if (a >= nv || b >= nv || c >= nv || a == b || b == c || c == a)
+            removed[t] = 1;
+        else
+            triangles++;
+    }
+
+    // Each vertex starts with the planes of its own triangles
+    for (size_t t = 0; t < nt; t++) {
+        if (removed[t]) continue;
+        const float* a = verts[corner[3 * t]].pos;
+        const float* b = verts[corner[3 * t + 1]].pos;
+        const float* c = verts[corner[3 * t + 2]].pos;
+
+        double ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+        double wx = c[0] - a[0], wy = c[1] - a[1], wz = c[2] - a[2];
+        double nx = uy * wz - uz * wy, ny = uz * wx - ux * wz, nz = ux * wy - uy * wx;
+        double len = sqrt(nx * nx + ny * ny + nz * nz);
+        if (len == 0.0) continue;
+        nx /= len; ny /= len; nz /= len;
+
+        Quadric plane;
+        plane.addPlane(nx, ny, nz, -(nx * a[0] + ny * a[1] + nz * a[2]));
+        for (int i = 0; i < 3; i++)
+            verts[corner[3 * t + i]].quadric.add(plane);
+    }
+
+    // Outgoing half-edges of every vertex, bucketed by start vertex
+    vector<uint32_t> offsets(nv + 1, 0), bucket;
+    for (size_t h = 0; h < corner.size(); h++)
+        if (!removed[h / 3]) offsets[corner[h] + 1]++;
+    for (size_t v = 0; v < nv; v++)
+        offsets[v + 1] += offsets[v];
+    bucket.resize(offsets[nv]);
+    {
+        vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t h = 0; h < corner.size(); h++)
+            if (!removed[h / 3]) bucket[fill[corner[h]]++] = (uint32_t)h;
+    }
+
+    // Pair a -> b with b -> a, but only where each direction occurs once.
+    // Anything else is non-manifold or wound inconsistently and stays a boundary.
+    for (size_t h = 0; h < corner.size(); h++) {
+        if (removed[h / 3]) continue;
+        uint32_t a = corner[h], b = corner[nextEdge((uint32_t)h)];
+
+        uint32_t match = NONE;
+        int backward = 0, forward = 0;
+        for (uint32_t i = offsets[b]; i < offsets[b + 1]; i++)
+            if (corner[nextEdge(bucket[i])] == a) { match = bucket[i]; backward++; }
+        for (uint32_t i = offsets[a]; i < offsets[a + 1]; i++)
+            if (corner[nextEdge(bucket[i])] == b) forward++;
+
+        if (backward == 1 && forward == 1)
+            twin[h] = match;
+    }
+
+    for (size_t v = 0; v < nv; v++)
+        if (offsets[v] < offsets[v + 1]) verts[v].edge = bucket[offsets[v]];
+
+    // Boundary vertices never move or go away, so the outline is kept
+    for (size_t h = 0; h < corner.size(); h++) {
+        if (removed[h / 3] || twin[h] != NONE) continue;
+        verts[corner[h]].locked = 1;
+        verts[corner[nextEdge((uint32_t)h)]].locked = 1;
+    }
+
+    // Two fans meeting at one vertex: the walk around it misses some triangles
+    vector<uint32_t> ring;
+    for (size_t v = 0; v < nv; v++) {
+        if (verts[v].edge == NONE || verts[v].locked) continue;
+        outgoing((uint32_t)v, ring);
+        if (ring.size() != offsets[v + 1] - offsets[v])
+            verts[v].locked = 1;
+    }
+}
+
+// Outgoing half-edges around v, found by walking the fan from its edge.
+// At a boundary the walk stops and continues from the start the other way.
+void Simplifier::outgoing(uint32_t v, vector<uint32_t>& out) const {
+    out.clear();
+    uint32_t start = verts[v].edge;
+    if (start == NONE) return;
+
+    uint32_t h = start;
+    for (;;) {
+        out.push_back(h);
+        uint32_t t = twin[prevEdge(h)];
+        if (t == start) return;
+        if (t == NONE) break;
+        h = t;
+    }
+
+    h = start;
+    for (;;) {
+        uint32_t t = twin[h];
+        if (t == NONE) return;
+        h = nextEdge(t);
+        out.push_back(h);
+    }
+}
+
+// Which end of the edge at h survives and where it goes. On return h starts
+// at the survivor. A boundary vertex always survives and stays put.
+bool Simplifier::plan(uint32_t& h, double p[3], double& cost) const {
+    uint32_t a = corner[h], b = corner[nextEdge(h)];
+    if (verts[a].locked && verts[b].locked) return false;
+    if (verts[b].locked) {
+        h = twin[h];
+        if (h == NONE) return false;
+        swap(a, b);
+    }
+
+    Quadric q = verts[a].quadric;
+    q.add(verts[b].quadric);
+
+    const float* pa = verts[a].pos;
+    const float* pb = verts[b].pos;
+    double best = 1e300;
+
+    auto consider = [&](double x, double y, double z) {
+        double e = q.error(x, y, z);
+        if (e < best) {
+            best = e;
+            p[0] = x; p[1] = y; p[2] = z;
+        }
+    };
+
+    if (verts[a].locked) {
+        consider(pa[0], pa[1], pa[2]);
+    } else {
+        // The quadric minimum, unless it is ill-defined or lands more than an
+        // edge length away, in which case the ends and the midpoint are tried
+        double m[3] = {0.0, 0.0, 0.0};
+        double mid[3] = {0.5 * (pa[0] + pb[0]), 0.5 * (pa[1] + pb[1]), 0.5 * (pa[2] + pb[2])};
+        double len2 = 0.0, dist2 = 0.0;
+        bool solved = q.minimum(m);
+        for (int i = 0; i < 3; i++) {
+            len2 += (pb[i] - pa[i]) * (pb[i] - pa[i]);
+            dist2 += (m[i] - mid[i]) * (m[i] - mid[i]);
+        }
+
+        if (solved && dist2 <= len2) {
+            consider(m[0], m[1], m[2]);
+        } else {
+            consider(pa[0], pa[1], pa[2]);
+            consider(pb[0], pb[1], pb[2]);
+            consider(mid[0], mid[1], mid[2]);
+        }
+    }
+
+    cost = std::max(0.0, best);
+    return true;
+}
+
+// True if moving the ring's centre vertex to p turns any of its triangles
+// (other than t0 and t1, which go away) by more than about 85 degrees
+bool Simplifier::flips(const vector<uint32_t>& ring, uint32_t t0, uint32_t t1, const double p[3]) const {
+    for (uint32_t g : ring) {
+        uint32_t t = g / 3;
+        if (t == t0 || t == t1) continue;
+
+        const float* o = verts[corner[g]].pos;
+        const float* x = verts[corner[nextEdge(g)]].pos;
+        const float* y = verts[corner[prevEdge(g)]].pos;
+
+        double before[3], after[3];
+        {
+            double ux = x[0] - o[0], uy = x[1] - o[1], uz = x[2] - o[2];
+            double wx = y[0] - o[0], wy = y[1] - o[1], wz = y[2] - o[2];
+            before[0] = uy * wz - uz * wy; before[1] = uz * wx - ux * wz; before[2] = ux * wy - uy * wx;
+        }
+        {
+            double ux = x[0] - p[0], uy = x[1] - p[1], uz = x[2] - p[2];
+            double wx = y[0] - p[0], wy = y[1] - p[1], wz = y[2] - p[2];
+            after[0] = uy * wz - uz * wy; after[1] = uz * wx - ux * wz; after[2] = ux * wy - uy * wx;
+        }
+
+        double b2 = before[0] * before[0] + before[1] * before[1] + before[2] * before[2];
+        double a2 = after[0] * after[0] + after[1] * after[1] + after[2] * after[2];
+        if (b2 == 0.0) continue;
+        if (a2 <= 1e-12 * b2) return true;
+
+        double d = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        if (d < 0.1 * sqrt(a2 * b2)) return true;
+    }
+    return false;
+}
+
+bool Simplifier::canCollapse(uint32_t h, const double p[3]) {
+    uint32_t ht = twin[h];
+    if (ht == NONE) return false;
+
+    uint32_t v0 = corner[h], v1 = corner[ht];
+    uint32_t a = corner[prevEdge(h)], b = corner[prevEdge(ht)];
+    if (a == b) return false;
+
+    outgoing(v0, ring0);
+    outgoing(v1, ring1);
+
+    // Link condition: the two ends may only share the neighbours a and b,
+    // or the collapse would pinch the surface
+    if (++markStamp == 0) {
+        for (VertexState& v : verts)
+            v.mark = 0;
+        markStamp = 1;
+    }
+    for (uint32_t g : ring0) {
+        verts[corner[nextEdge(g)]].mark = markStamp;
+        verts[corner[prevEdge(g)]].mark = markStamp;
+    }
+    int shared = 0;
+    for (uint32_t g : ring1) {
+        uint32_t n = corner[nextEdge(g)];
+        if (n != v0 && verts[n].mark == markStamp) shared++;
+    }
+    if (shared != 2) return false;
+
+    // A valence 3 v1 leaves one triangle v0 a b; it must not already exist
+    if (ring1.size() == 3) {
+        for (uint32_t g : ring0) {
+            uint32_t x = corner[nextEdge(g)], y = corner[prevEdge(g)];
+            if ((x == a && y == b) || (x == b && y == a)) {
+                if (g / 3 != h / 3 && g / 3 != ht / 3) return false;
+            }
+        }
+    }
+
+    uint32_t t0 = h / 3, t1 = ht / 3;
+    if (flips(ring1, t0, t1, p)) return false;
+    if (flips(ring0, t0, t1, p)) return false;
+    return true;
+}
+
+// Merges v1 (the end of h) into v0 (its start) at p. The two triangles on
+// the edge go away and their outer edges are zipped together.
+void Simplifier::collapse(uint32_t h, const double p[3]) {
+    uint32_t ht = twin[h];
+    uint32_t v0 = corner[h], v1 = corner[ht];
+    uint32_t t0 = h / 3, t1 = ht / 3;
+
+    uint32_t a = corner[prevEdge(h)], b = corner[prevEdge(ht)];
+    uint32_t A = twin[nextEdge(h)];   // a -> v1
+    uint32_t B = twin[prevEdge(h)];   // v0 -> a
+    uint32_t C = twin[nextEdge(ht)];  // b -> v0
+    uint32_t D = twin[prevEdge(ht)];  // v1 -> b
+
+    // ring1 still holds v1's fan from canCollapse
+    for (uint32_t g : ring1)
+        if (g / 3 != t0 && g / 3 != t1) corner[g] = v0;
+
+    if (A != NONE) twin[A] = B;
+    if (B != NONE) twin[B] = A;
+    if (C != NONE) twin[C] = D;
+    if (D != NONE) twin[D] = C;
+
+    for (uint32_t t : {t0, t1}) {
+        removed[t] = 1;
+        for (int i = 0; i < 3; i++) {
+            twin[3 * t + i] = NONE;
+            queuedCost[3 * t + i] = -1.0f;
+        }
+    }
+    triangles -= 2;
+
+    // v1 is interior, so A and D exist
+    verts[v0].edge = D;
+    verts[a].edge = A;
+    verts[b].edge = C != NONE ? C : nextEdge(D);
+    verts[v1].edge = NONE;
+
+    verts[v0].quadric.add(verts[v1].quadric);
+    for (int i = 0; i < 3; i++)
+        verts[v0].pos[i] = (float)p[i];
+}
+
+// Queues the edge at h with its current cost. Any older entry for the same
+// edge, from either side, becomes stale.
+void Simplifier::queueEdge(uint32_t h, CollapseQueue& queue) {
+    if (twin[h] != NONE) queuedCost[twin[h]] = -1.0f;
+    queuedCost[h] = -1.0f;
+
+    double p[3], cost;
+    if (!plan(h, p, cost)) return;
+
+    queuedCost[h] = (float)cost;
+    queue.push(QueueEntry{(float)cost, h});
+}
+
+void Simplifier::run(const SimplifyOptions& options, SimplifyStats& stats) {
+    stats.trianglesBefore = triangles;
+
+    // Every interior edge once
+    CollapseQueue queue;
+    for (uint32_t h = 0; h < corner.size(); h++)
+        if (twin[h] != NONE && h < twin[h]) queueEdge(h, queue);
+
+    double maxCost = (double)options.maxError * options.maxError;
+
+    while (triangles > options.targetTriangles && !queue.empty()) {
+        QueueEntry e = queue.top();
+        queue.pop();
+
+        uint32_t h = e.h;
+        if (queuedCost[h] != e.cost) continue;
+        if (e.cost > maxCost) break;
+
+        double p[3], cost;
+        if (!plan(h, p, cost)) continue;
+        if (!canCollapse(h, p)) {
+            stats.rejected++;
+            continue;
+        }
+
+        uint32_t v0 = corner[h];
+        collapse(h, p);
+        stats.collapses++;
+        stats.maxError = std::max(stats.maxError, (float)sqrt(cost));
+
+        // Every edge around the survivor has a new cost. Its fan was just
+        // walked by canCollapse, so this is all in cache.
+        outgoing(v0, ring0);
+        for (uint32_t g : ring0)
+            queueEdge(g, queue);
+    }
+
+    stats.trianglesAfter = triangles;
+}
+
+IndexedMesh Simplifier::result() const {
+    IndexedMesh out;
+    vector<uint32_t> remap(verts.size(), NONE);
+
+    out.indices.reserve(triangles * 3);
+    for (size_t t = 0; t < removed.size(); t++) {
+        if (removed[t]) continue;
+        for (int i = 0; i < 3; i++)
+            out.indices.push_back(corner[3 * t + i]);
+    }
+
+    // Renumber in the original vertex order
+    for (uint32_t v : out.indices)
+        remap[v] = 0;
+    uint32_t count = 0;
+    for (size_t v = 0; v < remap.size(); v++) {
+        if (remap[v] == NONE) continue;
+        remap[v] = count++;
+        out.vertices.insert(out.vertices.end(), verts[v].pos, verts[v].pos + 3);
+    }
+    for (uint32_t& v : out.indices)
+        v = remap[v];
+
+    return out;
+}
+
+}
+
+IndexedMesh simplify_mesh(const IndexedMesh& mesh, const SimplifyOptions& options, SimplifyStats* stats) {
+    SimplifyStats local;
+    Simplifier simplifier(mesh);
+    simplifier.run(options, stats ? *stats : local);
+    return simplifier.result();
+}
+
+IndexedMesh simplify_mesh(const IndexedMesh& mesh, float keepRatio, SimplifyStats* stats) {
+    SimplifyOptions options;
+    keepRatio = std::min(1.0f, std::max(0.0f, keepRatio));
+    options.targetTriangles = (size_t)(keepRatio * (mesh.indices.size() / 3));
+    return simplify_mesh(mesh, options, stats);
+}
+
+vector<float> unweld(const IndexedMesh& mesh) {
+    vector<float> soup;
+    soup.reserve(mesh.indices.size() * 3);
+    for (uint32_t v : mesh.indices)
+        soup.insert(soup.end(), &mesh.vertices[v * 3], &mesh.vertices[v * 3] + 3);
+    return soup;
+}
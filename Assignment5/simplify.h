@@ -0,0 +1,50 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <vector>
+#include <cstddef>
+
+#include "marching_cubes.h"
+
+// Quadric error edge-collapse simplification (Garland and Heckbert). Every
+// vertex carries the sum of the squared-distance quadrics of the planes of
+// its original triangles. Collapsing an edge merges the two quadrics and
+// places the surviving vertex where the merged quadric is smallest. Edges are
+// collapsed cheapest first from a priority queue, and the edges around each
+// collapse are queued again with their new costs.
+//
+// Connectivity is kept in flat half-edge arrays: half-edge h belongs to
+// triangle h / 3, starts at corner h and has its opposite in twin[h]. A
+// collapse is only made if it keeps the mesh manifold (link condition) and
+// turns no triangle over. Open boundaries, non-manifold edges and vertices,
+// and inconsistently wound triangles are left exactly where they are.
+//
+// Runs after marching_cubes_indexed (or dual_contouring, or any other welded
+// mesh). Marching cubes puts many thin triangles on flat and gently curved
+// parts, and these go first.
+struct SimplifyOptions {
+    size_t targetTriangles = 0;   // stop once this many triangles or fewer are left
+    float maxError = 1e30f;       // and never make a collapse with an error above this
+};
+
+struct SimplifyStats {
+    size_t trianglesBefore = 0;
+    size_t trianglesAfter = 0;
+    size_t collapses = 0;
+    size_t rejected = 0;          // collapses refused by the link or flip checks
+    float maxError = 0.0f;        // largest error of a collapse that was made
+};
+
+// The error of a collapse is the square root of the merged quadric at the new
+// position, which is about how far the surface has moved there, in the same
+// units as the vertices. The result is compacted: unused vertices dropped and
+// the rest renumbered in their original order.
+IndexedMesh simplify_mesh(const IndexedMesh& mesh, const SimplifyOptions& options, SimplifyStats* stats = nullptr);
+
+// Shortcut for keeping a fraction (0 to 1) of the triangles
+IndexedMesh simplify_mesh(const IndexedMesh& mesh, float keepRatio, SimplifyStats* stats = nullptr);
+
+// Triangle soup, 9 floats per triangle, for the soup-based renderers and writers
+std::vector<float> unweld(const IndexedMesh& mesh);
+
+#endif
@@ -0,0 +1,216 @@
+#include "volume.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static size_t voxelSize(VoxelType type) {
+    switch (type) {
+        case VoxelType::UInt16: return 2;
+        case VoxelType::Float32: return 4;
+        default: return 1;
+    }
+}
+
+RawVolume::~RawVolume() {
+    close();
+}
+
+RawVolume::RawVolume(RawVolume&& other) noexcept {
+    *this = std::move(other);
+}
+
+RawVolume& RawVolume::operator=(RawVolume&& other) noexcept {
+    if (this != &other) {
+        close();
+        mapping = other.mapping;
+        mappingSize = other.mappingSize;
+        voxels = other.voxels;
+        memcpy(dims, other.dims, sizeof(dims));
+        voxelType = other.voxelType;
+#ifdef _WIN32
+        fileHandle = other.fileHandle;
+        mappingHandle = other.mappingHandle;
+        other.fileHandle = nullptr;
+        other.mappingHandle = nullptr;
+#endif
+        other.mapping = nullptr;
+        other.voxels = nullptr;
+        other.mappingSize = 0;
+    }
+    return *this;
+}
+
+bool RawVolume::open(const string& fileName, int dimX, int dimY, int dimZ, VoxelType type, size_t headerBytes) {
+    close();
+
+    if (dimX < 2 || dimY < 2 || dimZ < 2) {
+        cerr << "RawVolume: need at least 2 voxels along each axis" << endl;
+        return false;
+    }
+    size_t needed = headerBytes + (size_t)dimX * dimY * dimZ * voxelSize(type);
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        cerr << "Error opening file: " << fileName << endl;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (size_t)size.QuadPart < needed) {
+        cerr << "RawVolume: " << fileName << " is smaller than the volume" << endl;
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* view = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!view) {
+        cerr << "RawVolume: could not map " << fileName << endl;
+        if (map) CloseHandle(map);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = map;
+    mapping = view;
+    mappingSize = (size_t)size.QuadPart;
+#else
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "Error opening file: " << fileName << endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < needed) {
+        cerr << "RawVolume: " << fileName << " is smaller than the volume" << endl;
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // The mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        cerr << "RawVolume: could not map " << fileName << endl;
+        return false;
+    }
+
+    mapping = view;
+    mappingSize = st.st_size;
+#endif
+
+    voxels = static_cast<const unsigned char*>(mapping) + headerBytes;
+    dims[0] = dimX;
+    dims[1] = dimY;
+    dims[2] = dimZ;
+    voxelType = type;
+    return true;
+}
+
+void RawVolume::close() {
+    if (!mapping) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle((HANDLE)mappingHandle);
+    CloseHandle((HANDLE)fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(mapping, mappingSize);
+#endif
+
+    mapping = nullptr;
+    mappingSize = 0;
+    voxels = nullptr;
+}
+
+template <typename T>
+static inline float loadVoxel(const unsigned char* voxels, size_t index) {
+    T value;
+    memcpy(&value, voxels + index * sizeof(T), sizeof(T));
+    return (float)value;
+}
+
+float RawVolume::voxel(int i, int j, int k) const {
+    size_t index = ((size_t)k * dims[1] + j) * dims[0] + i;
+    switch (voxelType) {
+        case VoxelType::UInt16: return loadVoxel<uint16_t>(voxels, index);
+        case VoxelType::Float32: return loadVoxel<float>(voxels, index);
+        default: return loadVoxel<uint8_t>(voxels, index);
+    }
+}
+
+// Trilinear interpolation for one voxel type, so the type is switched on once
+// per sample instead of once per voxel read
+template <typename T>
+static float trilinear(const unsigned char* voxels, const int dims[3], float x, float y, float z) {
+    float p[3] = {x, y, z};
+    int i0[3];
+    float t[3];
+    for (int a = 0; a < 3; a++) {
+        // Clamp into the volume and keep i0 + 1 inside it
+        float c = std::clamp(p[a], 0.0f, (float)(dims[a] - 1));
+        i0[a] = std::min((int)c, dims[a] - 2);
+        t[a] = c - i0[a];
+    }
+
+    size_t sx = 1, sy = dims[0], sz = (size_t)dims[0] * dims[1];
+    size_t base = i0[2] * sz + i0[1] * sy + i0[0];
+
+    float c000 = loadVoxel<T>(voxels, base);
+    float c100 = loadVoxel<T>(voxels, base + sx);
+    float c010 = loadVoxel<T>(voxels, base + sy);
+    float c110 = loadVoxel<T>(voxels, base + sy + sx);
+    float c001 = loadVoxel<T>(voxels, base + sz);
+    float c101 = loadVoxel<T>(voxels, base + sz + sx);
+    float c011 = loadVoxel<T>(voxels, base + sz + sy);
+    float c111 = loadVoxel<T>(voxels, base + sz + sy + sx);
+
+    float c00 = c000 + t[0] * (c100 - c000);
+    float c10 = c010 + t[0] * (c110 - c010);
+    float c01 = c001 + t[0] * (c101 - c001);
+    float c11 = c011 + t[0] * (c111 - c011);
+    float c0 = c00 + t[1] * (c10 - c00);
+    float c1 = c01 + t[1] * (c11 - c01);
+    return c0 + t[2] * (c1 - c0);
+}
+
+float RawVolume::sample(float x, float y, float z) const {
+    switch (voxelType) {
+        case VoxelType::UInt16: return trilinear<uint16_t>(voxels, dims, x, y, z);
+        case VoxelType::Float32: return trilinear<float>(voxels, dims, x, y, z);
+        default: return trilinear<uint8_t>(voxels, dims, x, y, z);
+    }
+}
+
+Grid RawVolume::voxelGrid() const {
+    return Grid{0.0f, 0.0f, 0.0f,
+        (float)(dims[0] - 1), (float)(dims[1] - 1), (float)(dims[2] - 1),
+        dims[0] - 1, dims[1] - 1, dims[2] - 1};
+}
+
+vector<float> marching_cubes_volume(const RawVolume& volume, float isovalue, unsigned numThreads) {
+    return marching_cubes_volume(volume, isovalue, volume.voxelGrid(), numThreads);
+}
+
+vector<float> marching_cubes_volume(const RawVolume& volume, float isovalue, const Grid& grid, unsigned numThreads) {
+    if (!volume.isOpen()) return vector<float>();
+    return marching_cubes_parallel(volume, isovalue, grid, numThreads);
+}
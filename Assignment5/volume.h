@@ -0,0 +1,71 @@
+#ifndef VOLUME_H
+#define VOLUME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "marching_cubes.h"
+
+enum class VoxelType { UInt8, UInt16, Float32 };
+
+// A raw voxel file (dimX * dimY * dimZ voxels, x fastest, then y, then z,
+// native byte order) mapped into memory read-only. Nothing is copied: the OS
+// pages in the parts of the file that are actually sampled, so opening a
+// multi-GB volume is instant and marching it slab by slab only touches the
+// slabs being marched.
+//
+// The volume is a scalar field in voxel coordinates: voxel (i, j, k) is at
+// (i, j, k), and positions in between are trilinearly interpolated. Positions
+// outside the volume are clamped to the border.
+class RawVolume {
+public:
+    RawVolume() {}
+    ~RawVolume();
+
+    RawVolume(RawVolume&& other) noexcept;
+    RawVolume& operator=(RawVolume&& other) noexcept;
+    RawVolume(const RawVolume&) = delete;
+    RawVolume& operator=(const RawVolume&) = delete;
+
+    // headerBytes skips a fixed size header in front of the voxels. Returns
+    // false if the file cannot be mapped or is smaller than the volume.
+    bool open(const std::string& fileName, int dimX, int dimY, int dimZ, VoxelType type, size_t headerBytes = 0);
+    void close();
+
+    bool isOpen() const { return voxels != nullptr; }
+    int sizeX() const { return dims[0]; }
+    int sizeY() const { return dims[1]; }
+    int sizeZ() const { return dims[2]; }
+    VoxelType type() const { return voxelType; }
+
+    // Value of one voxel, converted to float
+    float voxel(int i, int j, int k) const;
+
+    // Trilinear sample at a position in voxel coordinates
+    float sample(float x, float y, float z) const;
+
+    float operator()(float x, float y, float z) const { return sample(x, y, z); }
+
+    // One cell per pair of neighbouring voxels, so the lattice lands on the voxels
+    Grid voxelGrid() const;
+
+private:
+    void* mapping = nullptr;      // Start of the mapped file
+    size_t mappingSize = 0;
+    const unsigned char* voxels = nullptr;
+    int dims[3] = {0, 0, 0};
+    VoxelType voxelType = VoxelType::UInt8;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+// Marching cubes straight from the mapped voxels on the volume's own lattice,
+// or on any other grid in voxel coordinates, with the slab-parallel extractor
+std::vector<float> marching_cubes_volume(const RawVolume& volume, float isovalue, unsigned numThreads = 0);
+std::vector<float> marching_cubes_volume(const RawVolume& volume, float isovalue, const Grid& grid, unsigned numThreads = 0);
+
+#endif
@@ -237,6 +237,8 @@ int main(int argc, char* argv[]) {
 		glfwPollEvents();
 	} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && !glfwWindowShouldClose(window));
 
+	// GL objects go while the context is still alive
+	plane.release();
 	glfwTerminate();
 	return 0;
 }
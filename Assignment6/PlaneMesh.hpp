@@ -4,19 +4,35 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include "ShaderProgram.hpp"
+
 class PlaneMesh {
 	std::vector<float> verts;
 	std::vector<float> normals;
 	std::vector<unsigned int> indices;
 
 	GLuint VAO, VBO, NBO, EBO;
-	GLuint shaderID;
+	ShaderProgram shader;
 	GLuint waterTextureID, dispTextureID; // Optional
 
 	float min, max;
 	int numVerts, numIndices;
 	glm::vec4 modelColor;
 
+	// std140 mirror of the Frame block in the shaders. A vec3 takes 16 bytes
+	// unless a float follows it.
+	struct FrameUniforms {
+		glm::mat4 MVP;
+		glm::mat4 ModelMatrix;
+		glm::vec3 lightPos;
+		float pad;
+		glm::vec3 eyePos;
+		float time;
+	};
+
+	static const GLuint FRAME_BINDING = 0;
+	UniformBuffer frameBlock;
+
 	void planeMeshQuads(float min, float max, float stepsize) {
 		float y = 0;
 		for (float x = min; x <= max; x += stepsize) {
@@ -43,7 +59,7 @@ class PlaneMesh {
 
 public:
 	PlaneMesh(float min, float max, float stepsize, GLuint shaderProgram, GLuint waterTex = 0, GLuint dispTex = 0)
-		: shaderID(shaderProgram), waterTextureID(waterTex), dispTextureID(dispTex)
+		: shader(shaderProgram), waterTextureID(waterTex), dispTextureID(dispTex)
 	{
 		this->min = min;
 		this->max = max;
@@ -80,37 +96,42 @@ public:
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
 		glBindVertexArray(0);
+
+		// Per-frame values go through one uniform buffer
+		shader.bindBlock("Frame", FRAME_BINDING);
+		frameBlock.create(sizeof(FrameUniforms), FRAME_BINDING);
+
+		// These never change, so set them once here instead of every frame
+		shader.use();
+		glUniform1f(shader.location("outerTess"), 16.0f);
+		glUniform1f(shader.location("innerTess"), 8.0f);
+		glUniform1i(shader.location("waterTexture"), 0);
+		glUniform1i(shader.location("displacementTexture"), 1);
+		glUseProgram(0);
 	}
 
 	void draw(glm::vec3 lightPos, glm::mat4 V, glm::mat4 P) {
-		glUseProgram(shaderID);
+		shader.use();
 
 		glm::vec3 eye = glm::vec3(glm::inverse(V)[3]);
-		glm::mat4 ModelMatrix = glm::mat4(1.0f);
-		glm::mat4 MVP = P * V * ModelMatrix;
 
-		// Upload uniforms
-		glUniformMatrix4fv(glGetUniformLocation(shaderID, "ModelMatrix"), 1, GL_FALSE, glm::value_ptr(ModelMatrix));
-		glUniformMatrix4fv(glGetUniformLocation(shaderID, "MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
-		glUniform3fv(glGetUniformLocation(shaderID, "lightPos"), 1, glm::value_ptr(lightPos));
-		glUniform3fv(glGetUniformLocation(shaderID, "eyePos"), 1, glm::value_ptr(eye));
-
-		glUniform1f(glGetUniformLocation(shaderID, "outerTess"), 16.0f);
-		glUniform1f(glGetUniformLocation(shaderID, "innerTess"), 8.0f);
-
-		float t = glfwGetTime();
-		glUniform1f(glGetUniformLocation(shaderID, "time"), t);
+		FrameUniforms frame;
+		frame.ModelMatrix = glm::mat4(1.0f);
+		frame.MVP = P * V * frame.ModelMatrix;
+		frame.lightPos = lightPos;
+		frame.pad = 0.0f;
+		frame.eyePos = eye;
+		frame.time = glfwGetTime();
+		frameBlock.update(frame);
 
 		// Bind textures
 		if (waterTextureID != 0) {
 			glActiveTexture(GL_TEXTURE0);
 			glBindTexture(GL_TEXTURE_2D, waterTextureID);
-			glUniform1i(glGetUniformLocation(shaderID, "waterTexture"), 0);
 		}
 		if (dispTextureID != 0) {
 			glActiveTexture(GL_TEXTURE1);
 			glBindTexture(GL_TEXTURE_2D, dispTextureID);
-			glUniform1i(glGetUniformLocation(shaderID, "displacementTexture"), 1);
 		}
 
 
@@ -122,4 +143,9 @@ public:
 
 		glBindVertexArray(0);
 	}
+
+	// Deletes the uniform buffer; has to run before the context goes away
+	void release() {
+		frameBlock.release();
+	}
 };